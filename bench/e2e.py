@@ -0,0 +1,153 @@
+"""
+End-to-end throughput benchmark over the bundled example models.
+
+Runs ./BNGMM with a fixed, seeded configuration (bench/configs/<example>.csv) on every example, records wall time, PSO evaluations
+per second (from the <model>_profile.json written by BNGMM), peak RSS and the final (least) cost, and compares them against a stored
+baseline (bench/baseline.json by default).
+
+Usage (from the repository root, after building BNGMM):
+    python3 bench/e2e.py                       # run all examples and compare against bench/baseline.json
+    python3 bench/e2e.py --examples yeast      # run a subset
+    python3 bench/e2e.py --update-baseline     # store this run as the new baseline
+"""
+import csv
+import json
+import os
+import subprocess
+import sys
+import time
+from pathlib import Path
+
+REPO = Path(__file__).resolve().parent.parent
+CONFIGS = REPO / "bench" / "configs"
+
+# example name -> model file, time steps, optional true rates and held rates (all relative to example/<name>)
+EXAMPLES = {
+    "3_prot_linear_sim": {"model": "model.bngl", "times": "time_steps.csv", "rates": "true_rates.csv"},
+    "l3p_100_sim": {"model": "model.bngl", "times": "time_steps.csv", "rates": "true_rates.csv"},
+    "6_pro_nonlinear": {"model": "6pro.bngl", "times": "time_steps.csv", "rates": "true_rates.csv"},
+    "yeast": {"model": "yeast.bngl", "times": "time_steps.csv", "rates": "true_rates.csv", "held": "heldRates.csv"},
+    "birth_death_sim": {"model": "qbio_ssa_test.bngl", "times": str(CONFIGS / "birth_death_sim_time_steps.csv")},
+}
+
+# relative change allowed before a metric is reported as a regression
+DEFAULT_TOLERANCE = 0.10
+
+
+def getArg(flag, default=None):
+    if flag in sys.argv:
+        return sys.argv[sys.argv.index(flag) + 1]
+    return default
+
+
+def getList(flag):
+    if flag not in sys.argv:
+        return []
+    values = []
+    for arg in sys.argv[sys.argv.index(flag) + 1:]:
+        if arg.startswith("--"):
+            break
+        values.append(arg)
+    return values
+
+
+def command(name, spec, outDir, binary):
+    exampleDir = REPO / "example" / name
+    cmd = [binary,
+           "-m", str(exampleDir / spec["model"]),
+           "-x", str(exampleDir / "X"),
+           "-y", str(exampleDir / "Y"),
+           "-t", str(exampleDir / spec["times"]),
+           "-c", str(CONFIGS / (name + ".csv")),
+           "-o", str(outDir) + "/"]
+    if "rates" in spec:
+        cmd += ["-r", str(exampleDir / spec["rates"])]
+    if "held" in spec:
+        cmd += ["-hr", str(exampleDir / spec["held"])]
+    return cmd
+
+
+def runExample(name, spec, outRoot, binary):
+    outDir = outRoot / name
+    outDir.mkdir(parents=True, exist_ok=True)
+    cmd = command(name, spec, outDir, binary)
+    log = open(outDir / "bngmm_log.txt", "w")
+    start = time.perf_counter()
+    proc = subprocess.Popen(cmd, cwd=REPO, stdout=log, stderr=subprocess.STDOUT)
+    _, status, usage = os.wait4(proc.pid, 0)
+    wall = time.perf_counter() - start
+    log.close()
+    proc.returncode = os.waitstatus_to_exitcode(status)
+    if proc.returncode != 0:
+        print("%s failed with exit code %d, see %s" % (name, proc.returncode, outDir / "bngmm_log.txt"))
+        return None
+
+    modelName = Path(spec["model"]).stem
+    profile = json.load(open(outDir / (modelName + "_profile.json")))
+    evaluations = sum(step["evaluations"] for step in profile["steps"])
+    psoSeconds = sum(step["seconds"] for step in profile["steps"])
+    with open(outDir / (modelName + "_estimates.csv")) as f:
+        costs = [float(row["cost"]) for row in csv.DictReader(f)]
+    return {
+        "wallSeconds": wall,
+        "evalsPerSecond": evaluations / psoSeconds if psoSeconds > 0 else 0.0,
+        "peakRssMB": usage.ru_maxrss / 1024.0,  # linux reports kilobytes
+        "finalCost": min(costs),
+    }
+
+
+def compare(name, result, baseline, tolerance):
+    """Prints the change of every metric against the baseline and returns true if any of them regressed."""
+    if name not in baseline:
+        print("  no baseline for %s" % name)
+        return False
+    regressed = False
+    # metric -> +1 if bigger is better, -1 if smaller is better
+    for metric, direction in [("wallSeconds", -1), ("evalsPerSecond", 1), ("peakRssMB", -1), ("finalCost", -1)]:
+        old = baseline[name][metric]
+        new = result[metric]
+        change = (new - old) / old if old != 0 else 0.0
+        worse = direction * change < -tolerance
+        regressed = regressed or worse
+        print("  %-15s %14.4f -> %14.4f (%+7.1f%%)%s" % (metric, old, new, 100 * change, "  REGRESSION" if worse else ""))
+    return regressed
+
+
+if __name__ == "__main__":
+    if "-h" in sys.argv:
+        print(__doc__)
+        print("Other options: --binary <path to BNGMM> --out <output dir> --baseline <json> --tolerance <fraction>")
+        exit(0)
+    binary = getArg("--binary", str(REPO / "BNGMM"))
+    outRoot = Path(getArg("--out", str(REPO / "bench" / "output")))
+    baselinePath = Path(getArg("--baseline", str(REPO / "bench" / "baseline.json")))
+    tolerance = float(getArg("--tolerance", DEFAULT_TOLERANCE))
+    names = getList("--examples") or list(EXAMPLES.keys())
+
+    results = {}
+    for name in names:
+        print("Running %s ..." % name)
+        result = runExample(name, EXAMPLES[name], outRoot, binary)
+        if result is not None:
+            results[name] = result
+            print("  wall %.2f s | %.1f evals/s | peak RSS %.1f MB | final cost %.6g" % (result["wallSeconds"], result["evalsPerSecond"], result["peakRssMB"], result["finalCost"]))
+    json.dump(results, open(outRoot / "e2e_results.json", "w"), indent=2)
+
+    if "--update-baseline" in sys.argv:
+        baseline = json.load(open(baselinePath)) if baselinePath.exists() else {}
+        baseline.update(results)
+        json.dump(baseline, open(baselinePath, "w"), indent=2)
+        print("Updated baseline %s" % baselinePath)
+        exit(0)
+
+    if not baselinePath.exists():
+        print("No baseline found at %s, rerun with --update-baseline to store one." % baselinePath)
+        exit(0)
+    baseline = json.load(open(baselinePath))
+    print("---------------- Comparison against %s ----------------" % baselinePath)
+    regressed = False
+    for name, result in results.items():
+        print(name)
+        regressed = compare(name, result, baseline, tolerance) or regressed
+    failed = len(results) != len(names)
+    exit(1 if regressed or failed else 0)
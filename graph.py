@@ -5,6 +5,7 @@ import pandas as pd
 from pathlib import Path
 from textwrap import wrap
 import sys
+import shlex
 
 # def plot_confidence_interval(x, values, z=1.96, color='#2187bb', horizontal_line_width=0.25):
 #     mean = np.mean(x)
@@ -292,6 +293,45 @@ class Graph:
                 
         plt.savefig(filename + '.png')
         
+def render(args):
+    """Draws the single figure described by one graph.py argument list, i.e ['-f', 'file.csv', '-g', 'CI']"""
+    graphType = getGraphType(args)
+    if graphType == 'CI':
+        Graph.plotConfidenceIntervals(1.96, getFile(args), title=getName(args))
+    elif graphType == 'CI_truth':
+        Graph.plotConfidenceIntervals(1.96, getFile(args),simulated=True, trueRatesFile=getSimulatedRates(args), title=getName(args))
+    elif graphType == 'Moments':
+        Graph.plotMoments(getFile(args), title=getName(args), nSpecies= getMomentSubset(args))
+    elif graphType == 'dMoments':
+        dataX, dataY = getFile(args, multi=True)
+        Graph.plotMomentsWithActualEvolvedMatrices(dataX,dataY)
+    elif graphType =='allMoments':
+        dataX, dataY = getFile(args, multi=True)
+        Graph.plotAllMoments(dataX,dataY,title=getName(args))
+    elif graphType =='forecast':
+        forecasted, observed = getFile(args, multi=True)
+        Graph.plot_trajectories(forecasted=forecasted, observed=observed, title=getName(args), nSpecies=int(getMomentSubset(args)))
+    elif graphType == 'contour':
+        Graph.plot_contours(getFile(args), title=getName(args), nRates=int(getMomentSubset(args)))
+    else:
+        print("Error Invalid Graph Type Inputted:", graphType)
+        print("")
+
+def renderBatch(manifest):
+    """Draws every figure listed in a manifest written by BNGMM, one shell quoted graph.py argument list per line, in this one process"""
+    failed = 0
+    for line in open(manifest):
+        args = shlex.split(line)
+        if len(args) == 0:
+            continue
+        try:
+            render(args)
+        except Exception as e:
+            failed += 1
+            print("Error graphing", " ".join(args), ":", e)
+        plt.close('all') # every figure starts from a clean state, as it did when each figure had its own process
+    return failed
+
 if __name__ == "__main__": 
     # Graph.plot_contours("test/model_contour0_1.csv" , title="", nSpecies="")
     # Graph.plot_contours("test/model_contour1_2.csv" , title="", nSpecies="")
@@ -303,8 +343,13 @@ if __name__ == "__main__":
     if '-h' in sys.argv:
         print("Specify graphing type with -g <graph type> ")
         print("Specify files with -f <filename> <optional 2nd final name only if graph type is 'dMoments'>")
+        print("Or render a manifest of figures, one set of the above arguments per line, with -batch <manifest>")
         exit(0)
-            
+
+    plt.rcParams['figure.constrained_layout.use'] = True
+    if '-batch' in sys.argv:
+        exit(1 if renderBatch(sys.argv[sys.argv.index('-batch') + 1]) > 0 else 0)
+
     if "-f" not in sys.argv:
         print("Error Need to Specify Graph Files with -f")
         exit(0)
@@ -313,26 +358,5 @@ if __name__ == "__main__":
         print("Error Need to Specify Graph Types with -g")
         exit(0)
 
-    plt.rcParams['figure.constrained_layout.use'] = True
     plt.tight_layout()
-    graphType = getGraphType(sys.argv)
-    if graphType == 'CI':
-        Graph.plotConfidenceIntervals(1.96, getFile(sys.argv), title=getName(sys.argv))
-    elif graphType == 'CI_truth':
-        Graph.plotConfidenceIntervals(1.96, getFile(sys.argv),simulated=True, trueRatesFile=getSimulatedRates(sys.argv), title=getName(sys.argv))
-    elif graphType == 'Moments':
-        Graph.plotMoments(getFile(sys.argv), title=getName(sys.argv), nSpecies= getMomentSubset(sys.argv))
-    elif graphType == 'dMoments':
-        dataX, dataY = getFile(sys.argv, multi=True)
-        Graph.plotMomentsWithActualEvolvedMatrices(dataX,dataY)
-    elif graphType =='allMoments':
-        dataX, dataY = getFile(sys.argv, multi=True)
-        Graph.plotAllMoments(dataX,dataY,title=getName(sys.argv))
-    elif graphType =='forecast':
-        forecasted, observed = getFile(sys.argv, multi=True)
-        Graph.plot_trajectories(forecasted=forecasted, observed=observed, title=getName(sys.argv), nSpecies=int(getMomentSubset(sys.argv)))
-    elif graphType == 'contour':
-        Graph.plot_contours(getFile(sys.argv), title=getName(sys.argv), nRates=int(getMomentSubset(sys.argv)))
-    else:
-        print("Error Invalid Graph Type Inputted:", graphType)
-        print("")
\ No newline at end of file
+    render(sys.argv)
@@ -0,0 +1,149 @@
+/*
+Author: John Wu
+Summary: Microbenchmarks for the numerical kernels used in every PSO evaluation (moments, weights, costs, evolution matrices, velocity updates,
+bootstrapping, filtering and csv parsing). Results are printed as a table and written as json in the same layout as Google Benchmark's
+--benchmark_out_format=json so runs can be compared across commits.
+
+Usage:
+    ./bngmm_bench [--out bench.json] [--filter momentVector] [--min-time 0.25]
+ */
+#include "main.hpp"
+#include "calc.hpp"
+#include "fileIO.hpp"
+#include "linear.hpp"
+#include "nonlinear.hpp"
+#include <iomanip>
+
+struct BenchResult {
+    string name;
+    long iterations;
+    double nsPerIteration;
+};
+
+static vector<BenchResult> results;
+static double minTime = 0.25;
+static string nameFilter = "";
+
+/* keeps the optimizer from discarding results of benchmarked calls */
+static volatile double sink = 0;
+
+/*
+    Summary:
+        Runs fn in batches of doubling size until at least minTime seconds have elapsed and records the mean time per call.
+ */
+template <typename F>
+void benchmark(const string &name, F fn){
+    if(nameFilter != "" && name.find(nameFilter) == string::npos){
+        return;
+    }
+    fn(); // warm up caches and any lazy allocations
+    long iterations = 1;
+    double elapsed = 0;
+    while(true){
+        auto start = std::chrono::steady_clock::now();
+        for(long i = 0; i < iterations; ++i){
+            fn();
+        }
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if(elapsed >= minTime || iterations > (1L << 30)){
+            break;
+        }
+        iterations *= 2;
+    }
+    BenchResult r = {name, iterations, 1e9 * elapsed / iterations};
+    results.push_back(r);
+    cout << std::left << std::setw(40) << name << std::right << std::setw(16) << std::fixed << std::setprecision(1) << r.nsPerIteration << " ns" << std::setw(14) << iterations << endl;
+}
+
+/* Random abundance matrix with the occasional negative row so filterZeros has something to remove */
+MatrixXd randomCells(int nCells, int nSpecies, mt19937 &gen){
+    uniform_real_distribution<double> unif(0.0, 100.0);
+    MatrixXd cells(nCells, nSpecies);
+    for(int i = 0; i < nCells; ++i){
+        for(int j = 0; j < nSpecies; ++j){
+            cells(i,j) = unif(gen);
+        }
+        if(i % 50 == 0){
+            cells(i, 0) = -1;
+        }
+    }
+    return cells;
+}
+
+void writeJson(const string &path){
+    std::ofstream out(path);
+    if(!out.is_open()){
+        cout << "Unable to write benchmark results to " << path << endl;
+        return;
+    }
+    out.precision(9);
+    out << "{" << endl << "  \"context\": {\"executable\": \"bngmm_bench\", \"num_cpus\": " << omp_get_num_procs() << "}," << endl;
+    out << "  \"benchmarks\": [";
+    for(size_t i = 0; i < results.size(); ++i){
+        out << (i == 0 ? "" : ",") << endl << "    {\"name\": \"" << results[i].name << "\", \"run_type\": \"iteration\", \"iterations\": " << results[i].iterations
+            << ", \"real_time\": " << results[i].nsPerIteration << ", \"cpu_time\": " << results[i].nsPerIteration << ", \"time_unit\": \"ns\"}";
+    }
+    out << endl << "  ]" << endl << "}" << endl;
+    out.close();
+    cout << "Wrote benchmark results to " << path << endl;
+}
+
+int main(int argc, char** argv){
+    string outPath = "bench.json";
+    for(int i = 1; i < argc - 1; ++i){
+        string arg = argv[i];
+        if(arg == "--out"){
+            outPath = argv[i + 1];
+        }else if(arg == "--filter"){
+            nameFilter = argv[i + 1];
+        }else if(arg == "--min-time"){
+            minTime = std::stod(argv[i + 1]);
+        }
+    }
+    omp_set_num_threads(1); // kernels are benchmarked single threaded, parallelism lives in the PSO loop
+    mt19937 gen(42);
+    const vector<int> speciesCounts = {3, 6, 10};
+    const vector<int> cellCounts = {1000, 10000};
+
+    cout << std::left << std::setw(40) << "benchmark" << std::right << std::setw(19) << "time/iter" << std::setw(14) << "iterations" << endl;
+    for(int nSpecies : speciesCounts){
+        int nMoments = (nSpecies * (nSpecies + 3)) / 2;
+        for(int nCells : cellCounts){
+            string suffix = "/" + to_string(nSpecies) + "/" + to_string(nCells);
+            MatrixXd X = filterZeros(randomCells(nCells, nSpecies, gen));
+            MatrixXd Y = filterZeros(randomCells(nCells, nSpecies, gen)); // same rows are negative in both so X and Y line up
+
+            benchmark("momentVector" + suffix, [&](){ sink += momentVector(X, nMoments)(0); });
+            benchmark("wolfWtMat" + suffix, [&](){ sink += wolfWtMat(Y, nMoments, false)(0,0); });
+            benchmark("wolfWtMat_inverse" + suffix, [&](){ sink += wolfWtMat(Y, nMoments, true)(0,0); });
+            benchmark("dasWtMat_inverse" + suffix, [&](){ sink += dasWtMat(Y, X, nMoments, X.rows(), true)(0,0); });
+            benchmark("bootStrap" + suffix, [&](){ sink += bootStrap(X)(0,0); });
+            VectorXd counts = bootstrapCounts(Y.rows(), gen);
+            MatrixXd contributions = momentContributions(Y, nMoments);
+            VectorXd bootMoments;
+            MatrixXd bootWeights;
+            benchmark("bootstrapMoments_inverse" + suffix, [&](){ bootstrapMoments(contributions, counts, nSpecies, true, bootMoments, bootWeights); sink += bootWeights(0,0); });
+            MatrixXd unfiltered = randomCells(nCells, nSpecies, gen);
+            benchmark("filterZeros" + suffix, [&](){ sink += filterZeros(unfiltered).rows(); });
+
+            string csvPath = "bench_tmp_" + to_string(nSpecies) + "_" + to_string(nCells);
+            benchmark("matrixToCsv" + suffix, [&](){ matrixToCsv(X, csvPath); });
+            benchmark("csvToMatrix" + suffix, [&](){ sink += csvToMatrix(csvPath + ".csv")(0,0); });
+            std::remove((csvPath + ".csv").c_str());
+        }
+        VectorXd yMoments = VectorXd::Random(nMoments);
+        VectorXd xMoments = VectorXd::Random(nMoments);
+        MatrixXd w = wolfWtMat(randomCells(1000, nSpecies, gen), nMoments, true);
+        benchmark("costFunction/" + to_string(nSpecies), [&](){ sink += costFunction(yMoments, xMoments, w); });
+    }
+
+    /* the interaction matrix in system.cpp is defined for the 3 species linear model only */
+    VectorXd k = VectorXd::Constant(5, 0.3);
+    benchmark("evolutionMatrix/3", [&](){ sink += evolutionMatrix(k, 2.0, 3)(0,0); });
+    for(int nRates : {5, 10, 20}){
+        VectorXd pos = VectorXd::Constant(nRates, 0.5);
+        benchmark("adaptVelocity/" + to_string(nRates), [&](){ sink += adaptVelocity(pos, 7, 0.02, 0.005, 28)(0); });
+    }
+    writeJson(outPath);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,99 @@
+#include "bounds.hpp"
+
+RateBounds::RateBounds(int nRates, double hyperCubeScale){
+    lower = VectorXd::Zero(nRates);
+    upper = VectorXd::Constant(nRates, hyperCubeScale);
+    useLog = vector<bool>(nRates, false);
+}
+
+/*
+Summary:
+    Reads a bounds file with one row per bounded rate of the form index,lower,upper,log (log is 1 to search in log10 space and 0 otherwise),
+    formatted like the held rates file. Non numeric entries such as a header are ignored and rates not listed keep their default bounds.
+*/
+void RateBounds::read(const string &path){
+    std::ifstream input(path);
+    if(!input.is_open()){
+        throw std::runtime_error("Could not open rate bounds file " + path);
+    }
+    string line;
+    while(std::getline(input, line)){
+        std::stringstream ss(line);
+        string col;
+        vector<double> row;
+        while(std::getline(ss, col, ',')){
+            std::stringstream value(col); // bounds are often written in scientific notation, i.e 1e-4
+            double v;
+            if(value >> v){
+                row.push_back(v);
+            }
+        }
+        if(row.size() == 0){
+            continue;
+        }
+        if(row.size() != 4){
+            cout << "Error, every row of the rate bounds file must be index,lower,upper,log!" << endl;
+            exit(1);
+        }
+        int i = row[0];
+        if(i < 0 || i >= lower.size()){
+            cout << "Error, rate index " << i << " in the rate bounds file is out of range!" << endl;
+            exit(1);
+        }
+        if(row[2] <= row[1]){
+            cout << "Error, upper bound of rate " << i << " must be larger than its lower bound!" << endl;
+            exit(1);
+        }
+        if(row[3] != 0 && row[1] <= 0){
+            cout << "Error, log scale bounds of rate " << i << " must be positive!" << endl;
+            exit(1);
+        }
+        lower(i) = row[1];
+        upper(i) = row[2];
+        useLog[i] = row[3] != 0;
+    }
+    input.close();
+}
+
+double RateBounds::toRate(int i, double position) const {
+    if(useLog[i]){
+        double logLower = std::log10(lower(i));
+        return std::pow(10.0, logLower + position * (std::log10(upper(i)) - logLower));
+    }
+    return lower(i) + position * (upper(i) - lower(i));
+}
+
+/* Inverse of toRate, used to place held and seeded rates in the hypercube */
+double RateBounds::toPosition(int i, double rate) const {
+    if(useLog[i]){
+        if(rate <= 0){
+            return 0;
+        }
+        double logLower = std::log10(lower(i));
+        return (std::log10(rate) - logLower) / (std::log10(upper(i)) - logLower);
+    }
+    return (rate - lower(i)) / (upper(i) - lower(i));
+}
+
+VectorXd RateBounds::toRates(const VectorXd &positions) const {
+    VectorXd rates(positions.size());
+    for(int i = 0; i < positions.size(); ++i){
+        rates(i) = toRate(i, positions(i));
+    }
+    return rates;
+}
+
+VectorXd RateBounds::toPositions(const VectorXd &rates) const {
+    VectorXd positions(rates.size());
+    for(int i = 0; i < rates.size(); ++i){
+        positions(i) = toPosition(i, rates(i));
+    }
+    return positions;
+}
+
+void RateBounds::print() const {
+    cout << "Rate Search Bounds:" << endl;
+    for(int i = 0; i < lower.size(); ++i){
+        cout << i << ": [" << lower(i) << ", " << upper(i) << "] " << (useLog[i] ? "log" : "linear") << endl;
+    }
+}
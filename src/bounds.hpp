@@ -0,0 +1,27 @@
+#ifndef _BOUNDS_HPP_
+#define _BOUNDS_HPP_
+/*
+Author: John Wu
+Summary: Per rate search bounds of the PSO. Particles always move in the unit hypercube, each coordinate is mapped to its rate either
+linearly onto [lower, upper] or logarithmically (uniform in log10) so rates spanning several orders of magnitude are sampled evenly.
+Without a bounds file every rate is searched linearly on [0, Hyper Cube Width].
+ */
+#include "main.hpp"
+
+class RateBounds{
+    public:
+        RateBounds(int nRates, double hyperCubeScale);
+        void read(const string &path);
+        double toRate(int i, double position) const;
+        double toPosition(int i, double rate) const;
+        VectorXd toRates(const VectorXd &positions) const;
+        VectorXd toPositions(const VectorXd &rates) const;
+        bool logScale(int i) const { return useLog[i]; }
+        void print() const;
+    private:
+        VectorXd lower;
+        VectorXd upper;
+        vector<bool> useLog;
+};
+
+#endif
@@ -18,6 +18,7 @@ double rndNum(double low, double high){
 
 
 double costFunction(const VectorXd& trueVec, const  VectorXd& estVec, const MatrixXd& w) {
+    ScopedTimer timer(COST);
     double cost = 0;
     VectorXd diff(trueVec.size());
     diff = trueVec - estVec;
@@ -26,6 +27,7 @@ double costFunction(const VectorXd& trueVec, const  VectorXd& estVec, const Matr
 }
 /*TODO: Rename to wolfe weights */
 MatrixXd wolfWtMat(const MatrixXd& Yt, int nMoments, bool useInverse){
+    ScopedTimer timer(WEIGHTS);
     /* first moment differences */
     MatrixXd fmdiffs = MatrixXd::Zero(Yt.rows(), Yt.cols());
     for(int i = 0; i < Yt.cols(); i++){
@@ -112,8 +114,75 @@ MatrixXd wolfWtMat(const MatrixXd& Yt, int nMoments, bool useInverse){
     return wt;
 }
 
+/*
+Summary:
+    Per row moment contributions of Yt in moment order, i.e [x_i, x_i^2, x_i x_j]. Their column means give every moment and their covariance
+    is the covariance of the aDiff rows of wolfWtMat (which only differ by a constant per column), so they are computed once per Y file and
+    every bootstrap replicate is a weighted sum over them.
+*/
+MatrixXd momentContributions(const MatrixXd& Yt, int nMoments){
+    MatrixXd contributions(Yt.rows(), nMoments);
+    int moment = 0;
+    for(int i = 0; i < Yt.cols() && moment < nMoments; ++i, ++moment){
+        contributions.col(moment) = Yt.col(i);
+    }
+    for(int i = 0; i < Yt.cols() && moment < nMoments; ++i, ++moment){
+        contributions.col(moment) = Yt.col(i).array().square();
+    }
+    for(int i = 0; i < Yt.cols(); ++i){
+        for(int j = i + 1; j < Yt.cols() && moment < nMoments; ++j, ++moment){
+            contributions.col(moment) = Yt.col(i).array() * Yt.col(j).array();
+        }
+    }
+    return contributions;
+}
+
+/*
+Summary:
+    Moments and wolf weights of a bootstrap resample given as the number of times each row was drawn, equal to momentVector and wolfWtMat
+    of the materialized resample.
+Input:
+    contributions - momentContributions of the Y file
+    counts - number of times each row is drawn
+    nSpecies - number of columns of the Y file
+Output:
+    moments and weights of the replicate
+*/
+void bootstrapMoments(const MatrixXd& contributions, const VectorXd& counts, int nSpecies, bool useInverse, VectorXd& moments, MatrixXd& weights){
+    ScopedTimer timer(WEIGHTS);
+    int nMoments = contributions.cols();
+    double n = counts.sum();
+    double unbiased = n > 1 ? n / (n - 1) : 0;
+    VectorXd means = contributions.transpose() * counts / n;
+    moments = means;
+    int moment = nSpecies;
+    for(int i = 0; i < nSpecies && moment < nMoments; ++i, ++moment){
+        moments(moment) = (means(moment) - means(i) * means(i)) * unbiased;
+    }
+    for(int i = 0; i < nSpecies; ++i){
+        for(int j = i + 1; j < nSpecies && moment < nMoments; ++j, ++moment){
+            moments(moment) = (means(moment) - means(i) * means(j)) * unbiased;
+        }
+    }
+
+    MatrixXd centered = contributions.rowwise() - means.transpose();
+    weights = MatrixXd::Zero(nMoments, nMoments);
+    if(useInverse){
+        if(n > 1){
+            weights = centered.transpose() * counts.asDiagonal() * centered / (n - 1);
+        }
+        weights = weights.colPivHouseholderQr().solve(MatrixXd::Identity(nMoments, nMoments));
+    }else{
+        for(int i = 0; i < nMoments; i++){
+            double variance = n > 1 ? (counts.array() * centered.col(i).array().square()).sum() / (n - 1) : 0;
+            weights(i,i) = variance == 0 ? 1 : 1.0 / variance; // error check for invalid variances
+        }
+    }
+}
+
 /* TODO: Rename to Das Weights */
 MatrixXd dasWtMat(const MatrixXd& Yt, const MatrixXd& Xt, int nMoments, int N, bool useInverse){
+    ScopedTimer timer(WEIGHTS);
     if(Yt.rows() != Xt.rows() || Yt.cols() != Xt.cols()){
         cout << "Error! Dimension mismatch between X and Y! Calculation of Das Weights cancelled!" << endl;
         return MatrixXd::Identity(nMoments, nMoments);
@@ -203,6 +272,34 @@ MatrixXd bootStrap(const MatrixXd& sample){
     return bSample;
 }
 
+/* Stream of bootstrap draws that only depends on the base seed, the run and which matrix is resampled */
+mt19937 bootstrapGenerator(unsigned int seed, int run, int stream){
+    std::seed_seq sequence{seed, (unsigned int) run, (unsigned int) stream};
+    return mt19937(sequence);
+}
+
+/* Number of times each row is drawn when resampling nRows rows with replacement */
+VectorXd bootstrapCounts(int nRows, mt19937 &gen){
+    VectorXd counts = VectorXd::Zero(nRows);
+    std::uniform_int_distribution<> unif(0, nRows - 1);
+    for(int i = 0; i < nRows; ++i){
+        counts(unif(gen)) += 1;
+    }
+    return counts;
+}
+
+/* Materializes a resample from its counts, only needed for X which is simulated cell by cell */
+MatrixXd resampleRows(const MatrixXd &sample, const VectorXd &counts){
+    MatrixXd bSample(int(counts.sum()), sample.cols());
+    int row = 0;
+    for(int i = 0; i < sample.rows(); ++i){
+        for(int c = 0; c < counts(i); ++c){
+            bSample.row(row++) = sample.row(i);
+        }
+    }
+    return bSample;
+}
+
 VectorXd cwiseVar(const MatrixXd& sample){
     VectorXd variances(sample.cols());
     for(int c = 0; c < sample.cols(); ++c){
@@ -254,4 +351,68 @@ MatrixXd filterZeros(const MatrixXd &X){
 
 
 //     MatrixXd
-// }
\ No newline at end of file
+// }
+
+/*
+    Summary:
+        Multi fidelity schedule of the PSO. The fraction of cells simulated starts at initialFraction and doubles in equal step intervals
+        until all cells are used at step fullFidelityAt * nSteps. Discrete levels keep the number of fidelity changes (and re-evaluations
+        of the particle bests) small.
+*/
+double cellFraction(int step, int nSteps, double initialFraction, double fullFidelityAt){
+    if(initialFraction >= 1 || step >= fullFidelityAt * nSteps){
+        return 1;
+    }
+    int doublings = std::ceil(std::log2(1.0 / initialFraction));
+    int level = (doublings + 1) * step / (fullFidelityAt * nSteps);
+    return std::min(1.0, initialFraction * std::pow(2.0, level));
+}
+
+/* first fraction * rows of X in the given (shuffled) row order, at least one row */
+MatrixXd subsampleRows(const MatrixXd &X, const vector<int> &order, double fraction){
+    int n = std::max(1, int(std::ceil(fraction * X.rows())));
+    if(n >= X.rows()){
+        return X;
+    }
+    MatrixXd sub(n, X.cols());
+    for(int i = 0; i < n; ++i){
+        sub.row(i) = X.row(order[i]);
+    }
+    return sub;
+}
+
+/* diagonal of the bounding box of all particle positions */
+double swarmDiameter(const MatrixXd &positions){
+    return (positions.colwise().maxCoeff() - positions.colwise().minCoeff()).norm();
+}
+
+/*
+    Summary:
+        Checks the stopping rules after a PSO step.
+    Input:
+        GBMAT - global best of every step so far, cost in the last column
+        POSMAT - current particle positions
+        seconds, evaluations - wall time and cost evaluations of the run so far
+    Output:
+        why the run should stop, empty if it should continue
+*/
+string stoppingReason(const StoppingRules &rules, const MatrixXd &GBMAT, const MatrixXd &POSMAT, double seconds, long evaluations){
+    if(rules.maxSeconds > 0 && seconds >= rules.maxSeconds){
+        return "max wall time of " + to_string(rules.maxSeconds) + " s reached";
+    }
+    if(rules.maxEvaluations > 0 && evaluations >= rules.maxEvaluations){
+        return "max evaluations of " + to_string(rules.maxEvaluations) + " reached";
+    }
+    if(rules.swarmDiameter > 0 && swarmDiameter(POSMAT) < rules.swarmDiameter){
+        return "swarm diameter below " + to_string(rules.swarmDiameter);
+    }
+    int last = GBMAT.rows() - 1;
+    if(rules.window > 0 && rules.relativeImprovement > 0 && last >= rules.window){
+        double before = GBMAT(last - rules.window, GBMAT.cols() - 1);
+        double now = GBMAT(last, GBMAT.cols() - 1);
+        if((before - now) / std::max(std::abs(before), 1e-300) < rules.relativeImprovement){
+            return "relative improvement below " + to_string(rules.relativeImprovement) + " over " + to_string(rules.window) + " steps";
+        }
+    }
+    return "";
+}
@@ -1,16 +1,34 @@
 #ifndef _CALC_HPP_
 #define _CALC_HPP_
 #include "main.hpp"
+#include "profiler.hpp"
 bool isInvertible(const MatrixXd& m);
 double rndNum(double low, double high);
 double costFunction(const VectorXd& trueVec, const  VectorXd& estVec, const MatrixXd& w);
 MatrixXd wolfWtMat(const MatrixXd& Yt, int nMoments, bool useInverse);
+MatrixXd momentContributions(const MatrixXd& Yt, int nMoments);
+void bootstrapMoments(const MatrixXd& contributions, const VectorXd& counts, int nSpecies, bool useInverse, VectorXd& moments, MatrixXd& weights);
 MatrixXd dasWtMat(const MatrixXd& Yt, const MatrixXd& Xt, int nMoments, int N, bool useInverse);
 MatrixXd bootStrap(const MatrixXd& sample);
+mt19937 bootstrapGenerator(unsigned int seed, int run, int stream);
+VectorXd bootstrapCounts(int nRows, mt19937 &gen);
+MatrixXd resampleRows(const MatrixXd &sample, const VectorXd &counts);
 VectorXd cwiseVar(const MatrixXd& sample);
 void computeConfidenceIntervals(const MatrixXd& sample, double z, int nRates);
 bool rowIsAllPositive(const VectorXd &x);
 MatrixXd filterZeros(const MatrixXd &X);
+/* Convergence based stopping rules of a PSO run, a rule is off when its value is <= 0 */
+struct StoppingRules {
+    int window; // number of steps the relative improvement of the global best cost is measured over
+    double relativeImprovement;
+    double swarmDiameter; // in unit hypercube coordinates
+    double maxSeconds;
+    long maxEvaluations;
+};
+double swarmDiameter(const MatrixXd &positions);
+string stoppingReason(const StoppingRules &rules, const MatrixXd &GBMAT, const MatrixXd &POSMAT, double seconds, long evaluations);
+double cellFraction(int step, int nSteps, double initialFraction, double fullFidelityAt);
+MatrixXd subsampleRows(const MatrixXd &X, const vector<int> &order, double fraction);
 // MatrixXd generatePairwiseContour(const RoadRunner &model, const SimulateOptions &opt, const VectorXd &pos, int theta1, int theta2, int stepSize);
 
 #endif 
\ No newline at end of file
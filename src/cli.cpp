@@ -93,7 +93,10 @@ bool helpCall(int argc, char **argv){
         << "To specify data Y directory where true Y data files are located, do: ./BNGMM -y <DIRECTORY> i.e ./BNGMM -y to/Y/DIRECTORY" << endl
         << "To specify an output directory where output files such as graphing and output txt files, ./BNGMM -o <path> i.e ./BNGMM -o /frontend/graphs/6pro" << endl
         << "If you have more species in the system than observed protein species, then please supply a list of proteins in a .txt file." << endl
-        << "i.e ./BNGMM -p listOfObservedProteinsInOrder.txt " << endl;
+        << "i.e ./BNGMM -p listOfObservedProteinsInOrder.txt " << endl
+        << "To generate cost contours of pairs of rates, do: ./BNGMM --contour <rate1> <rate2> [<rate3> <rate4> ...] or ./BNGMM --contour all" << endl
+        << "To search rates within per rate (optionally log scale) bounds, do: ./BNGMM -b <path> i.e ./BNGMM -b bounds.csv" << endl
+        << "To choose how much is written after estimation, do: ./BNGMM --output=<minimal|standard|full>, minimal only writes the estimates (default full)" << endl;
         return true;
     }
     return false;
@@ -104,6 +107,11 @@ bool holdRates(int argc, char **argv){
     return flag != -1;
 }
 
+bool rateBoundsExist(int argc, char **argv){
+    int flag = getIndexFlag(argc, argv, "-b");
+    return flag != -1;
+}
+
 bool seedRates(int argc, char **argv){
     int flag = getIndexFlag(argc, argv, "-s");
     return flag != -1;
@@ -134,13 +142,14 @@ string getSBML(int argc, char**argv){
     return argv[flag+1];
 }
 
-string getContourTheta1(int argc, char**argv){
-    int flag = getIndexFlag(argc, argv, "--contour");
-    return argv[flag+1];
-}
-string getContourTheta2(int argc, char**argv){
+/* every name after --contour up to the next flag, consecutive names form a pair, "all" requests every pair */
+vector<string> getContourNames(int argc, char**argv){
     int flag = getIndexFlag(argc, argv, "--contour");
-    return argv[flag+2];
+    vector<string> names;
+    for(int i = flag + 1; i < argc && argv[i][0] != '-'; ++i){
+        names.push_back(argv[i]);
+    }
+    return names;
 }
 
 
@@ -149,6 +158,11 @@ string getHeldRatesDir(int argc, char **argv){
     return argv[flag+1];
 }
 
+string getRateBoundsPath(int argc, char **argv){
+    int flag = getIndexFlag(argc, argv, "-b");
+    return argv[flag+1];
+}
+
 string getSeededRates(int argc, char **argv){
     int flag = getIndexFlag(argc, argv, "-s");
     return argv[flag+1];
@@ -158,3 +172,25 @@ string getForecastedTimes(int argc, char **argv){
     int flag = getIndexFlag(argc, argv, "-f");
     return argv[flag+1];
 }
+
+/* accepts both --output=minimal and --output minimal, defaults to full output */
+OutputProfile getOutputProfile(int argc, char **argv){
+    string profile = "full";
+    for(int i = 0; i < argc; ++i){
+        string arg = argv[i];
+        if(arg.rfind("--output=", 0) == 0){
+            profile = arg.substr(9);
+        }else if(arg == "--output" && i + 1 < argc){
+            profile = argv[i + 1];
+        }
+    }
+    if(profile == "minimal"){
+        return MINIMAL_OUTPUT;
+    }else if(profile == "standard"){
+        return STANDARD_OUTPUT;
+    }else if(profile != "full"){
+        cout << "Error, unknown output profile " << profile << ", expected minimal, standard or full!" << endl;
+        exit(EXIT_FAILURE);
+    }
+    return FULL_OUTPUT;
+}
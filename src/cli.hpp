@@ -1,6 +1,8 @@
 #ifndef _CLI_HPP_
 #define _CLI_HPP_
 #include "main.hpp"
+/* What is written after estimation, minimal: estimates only, standard: + moment reports and graphs, full: + every simulated and observed cell matrix */
+enum OutputProfile { MINIMAL_OUTPUT, STANDARD_OUTPUT, FULL_OUTPUT };
 string getConfigPath(int argc, char **argv);
 string getTimeStepsPath(int argc, char **argv);
 string getTrueRatesPath(int argc, char **argv);
@@ -15,6 +17,7 @@ bool graphingEnabled(int argc, char **argv);
 bool proPathExists(int argc, char **argv);
 bool helpCall(int argc, char **argv);
 bool holdRates(int argc, char **argv);
+bool rateBoundsExist(int argc, char **argv);
 bool seedRates(int argc, char **argv);
 bool forecast(int argc, char **argv);
 bool contour(int argc, char **argv);
@@ -23,11 +26,12 @@ bool generateSurrogate(int argc, char**argv);
 
 string getSBML(int argc, char**argv);
 
-string getContourTheta1(int argc, char**argv);
-string getContourTheta2(int argc, char**argv);
+vector<string> getContourNames(int argc, char**argv);
 
 string getHeldRatesDir(int argc, char **argv);
+string getRateBoundsPath(int argc, char **argv);
 string getSeededRates(int argc, char **argv);
 string getForecastedTimes(int argc, char **argv);
+OutputProfile getOutputProfile(int argc, char **argv);
 #endif
 
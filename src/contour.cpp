@@ -0,0 +1,201 @@
+#include "contour.hpp"
+#include "fileIO.hpp"
+
+/* Position weighted sum, changes when values are edited or reordered */
+static double checksum(const double *values, long size){
+    double sum = 0;
+    for(long i = 0; i < size; ++i){
+        sum += values[i] * (1 + i % 101);
+    }
+    return sum;
+}
+
+/*
+Summary:
+    First line of a points file, describing everything the stored costs depend on: the pair, the grid resolution, the bounds of both
+    rates, the fixed rates and the initial and target data.
+*/
+string ContourGrid::identity(const VectorXd &theta, const MatrixXd &x0, const ContourPair &pair, const vector<string> &parameterNames) const {
+    std::stringstream header;
+    header.precision(12);
+    header << "# pair " << parameterNames[pair.first] << " " << parameterNames[pair.second] << " resolution " << resolution << " bounds";
+    for(int i : {pair.first, pair.second}){
+        header << " " << bounds.toRate(i, 0) << " " << bounds.toRate(i, 1) << (bounds.logScale(i) ? " log" : " linear");
+    }
+    header << " theta";
+    for(int i = 0; i < theta.size(); ++i){
+        header << " " << theta(i);
+    }
+    double targets = 0;
+    for(size_t t = 0; t < evaluator.targets().size(); ++t){
+        targets += (t + 1) * checksum(evaluator.targets()[t].data(), evaluator.targets()[t].size());
+    }
+    header << " x0 " << x0.rows() << "x" << x0.cols() << " " << checksum(x0.data(), x0.size()) << " targets " << targets;
+    return header.str();
+}
+
+/*
+Summary:
+    Reads the finished points of a previous, possibly interrupted, run. The first line of the points file must match header, every other
+    line is level,row,col,rate1,rate2,cost.
+Output:
+    done - one resolution x resolution cost matrix per level found in the file, NaN where a point has not been evaluated yet
+    returns false when the file exists but was written for a different grid or data set, in which case done is left empty
+*/
+bool ContourGrid::resume(const string &pointsFile, const string &header, vector<MatrixXd> &done){
+    std::ifstream input(pointsFile);
+    if(!input.is_open()){
+        return true;
+    }
+    string line;
+    if(!std::getline(input, line)){ // empty file
+        return true;
+    }
+    if(line != header){
+        return false;
+    }
+    while(std::getline(input, line)){
+        std::stringstream ss(line);
+        string col;
+        vector<double> row;
+        while(std::getline(ss, col, ',')){
+            std::stringstream value(col);
+            double v;
+            if(value >> v){
+                row.push_back(v);
+            }
+        }
+        if(row.size() != 6){ // column labels or a line cut off by the interruption
+            continue;
+        }
+        int level = row[0], i = row[1], j = row[2];
+        if(level < 0 || i < 0 || j < 0 || i >= resolution || j >= resolution){
+            continue;
+        }
+        while(static_cast<int>(done.size()) <= level){
+            done.push_back(MatrixXd::Constant(resolution, resolution, std::numeric_limits<double>::quiet_NaN()));
+        }
+        done[level](i,j) = row[5];
+    }
+    input.close();
+    return true;
+}
+
+/* Window around the minimum of a finished grid, spanning two grid spacings on either side and clipped to the hypercube */
+ContourWindow ContourGrid::zoom(const ContourWindow &previous) const {
+    int bestI = 0, bestJ = 0;
+    for(int i = 0; i < resolution; ++i){
+        for(int j = 0; j < resolution; ++j){
+            if(previous.cost(i,j) < previous.cost(bestI, bestJ) || std::isnan(previous.cost(bestI, bestJ))){
+                bestI = i;
+                bestJ = j;
+            }
+        }
+    }
+    double center1 = position(previous.low1, previous.high1, bestI);
+    double center2 = position(previous.low2, previous.high2, bestJ);
+    double width1 = 2 * (previous.high1 - previous.low1) / resolution;
+    double width2 = 2 * (previous.high2 - previous.low2) / resolution;
+    ContourWindow window;
+    window.low1 = std::max(0.0, center1 - width1);
+    window.high1 = std::min(1.0, center1 + width1);
+    window.low2 = std::max(0.0, center2 - width2);
+    window.high2 = std::min(1.0, center2 + width2);
+    return window;
+}
+
+void ContourGrid::write(const ContourWindow &window, const ContourPair &pair, const vector<string> &parameterNames, const string &fileName) const {
+    vector<string> labels = {parameterNames[pair.first], parameterNames[pair.second], "Cost"};
+    MatrixXd contour = MatrixXd::Zero(resolution * resolution, 3);
+    int cdx = 0;
+    for(int i = 0; i < resolution; ++i){
+        for(int j = 0; j < resolution; ++j){
+            contour(cdx, 0) = bounds.toRate(pair.first, position(window.low1, window.high1, i));
+            contour(cdx, 1) = bounds.toRate(pair.second, position(window.low2, window.high2, j));
+            contour(cdx, 2) = window.cost(i,j);
+            cdx++;
+        }
+    }
+    matrixToCsvWithLabels(contour, labels, fileName);
+}
+
+/*
+Summary:
+    Evaluates the cost on a resolution x resolution grid of every pair of rates with all other rates fixed at theta, followed by
+    refinements zoomed grids around each minimum. All points of a level, across every pair, run as one parallel loop. Points already
+    in <pair path>_points.csv are not recomputed, unless its header shows it was written for a different grid or data set.
+Output:
+    paths of the written contour csv files, the full grid of every pair first
+*/
+vector<string> ContourGrid::evaluate(const VectorXd &theta, const MatrixXd &x0, const vector<ContourPair> &pairs, const vector<string> &parameterNames){
+    int nPairs = pairs.size();
+    vector<vector<MatrixXd>> done(nPairs);
+    vector<std::ofstream> points(nPairs);
+    for(int p = 0; p < nPairs; ++p){
+        string pointsFile = pairs[p].path + "_points.csv";
+        string header = identity(theta, x0, pairs[p], parameterNames);
+        bool matches = resume(pointsFile, header, done[p]);
+        if(!matches){
+            cout << "Warning, " << pointsFile << " was written for a different grid, rates or data set, starting it over" << endl;
+        }
+        bool exists = done[p].size() > 0;
+        points[p].open(pointsFile, exists ? std::ios::app : std::ios::trunc);
+        points[p].precision(12);
+        if(!exists){
+            points[p] << header << endl;
+            points[p] << "level,row,col," << parameterNames[pairs[p].first] << "," << parameterNames[pairs[p].second] << ",cost" << endl;
+        }
+    }
+
+    vector<string> outputs;
+    vector<ContourWindow> windows(nPairs);
+    for(int level = 0; level <= refinements; ++level){
+        vector<std::array<int,3>> tasks; // (pair, row, col) of every point left to evaluate
+        for(int p = 0; p < nPairs; ++p){
+            if(level == 0){
+                windows[p] = {0, 1, 0, 1, MatrixXd()};
+            }else{
+                windows[p] = zoom(windows[p]);
+            }
+            windows[p].cost = level < static_cast<int>(done[p].size()) ? done[p][level] : MatrixXd::Constant(resolution, resolution, std::numeric_limits<double>::quiet_NaN());
+            for(int i = 0; i < resolution; ++i){
+                for(int j = 0; j < resolution; ++j){
+                    if(std::isnan(windows[p].cost(i,j))){
+                        tasks.push_back({p, i, j});
+                    }
+                }
+            }
+        }
+        cout << "Contour level " << level << ": evaluating " << tasks.size() << " of " << nPairs * resolution * resolution << " grid points" << endl;
+
+    #pragma omp parallel for schedule(dynamic)
+        for(int t = 0; t < static_cast<int>(tasks.size()); ++t){
+            int p = tasks[t][0], i = tasks[t][1], j = tasks[t][2];
+            const ContourPair &pair = pairs[p];
+            random_device pRanDev;
+            mt19937 pGen(pRanDev());
+            if(baseSeed > 0){
+                pGen.seed(baseSeed + ((long(level) * nPairs + p) * resolution + i) * resolution + j);
+            }
+            VectorXd pTheta = theta;
+            pTheta(pair.first) = bounds.toRate(pair.first, position(windows[p].low1, windows[p].high1, i));
+            pTheta(pair.second) = bounds.toRate(pair.second, position(windows[p].low2, windows[p].high2, j));
+            double cost = evaluator.cost(pTheta, x0, pGen);
+        #pragma omp critical
+        {
+            windows[p].cost(i,j) = cost;
+            points[p] << level << "," << i << "," << j << "," << pTheta(pair.first) << "," << pTheta(pair.second) << "," << cost << endl; // flushed so an interrupted run can resume
+        }
+        }
+
+        for(int p = 0; p < nPairs; ++p){
+            string fileName = level == 0 ? pairs[p].path : pairs[p].path + "_refined" + to_string(level);
+            write(windows[p], pairs[p], parameterNames, fileName);
+            outputs.push_back(fileName + ".csv");
+        }
+    }
+    for(int p = 0; p < nPairs; ++p){
+        points[p].close();
+    }
+    return outputs;
+}
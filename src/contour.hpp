@@ -0,0 +1,45 @@
+#ifndef _CONTOUR_HPP_
+#define _CONTOUR_HPP_
+/*
+Author: John Wu
+Summary: Pairwise cost contours. Every grid point of every requested pair of rates is an independent task scheduled over the per thread
+model pool, finished points are streamed to a points file so an interrupted run resumes where it stopped, and each grid can be followed
+by zoomed grids around its minimum.
+ */
+#include "main.hpp"
+#include "simulator.hpp"
+#include "bounds.hpp"
+#include <array>
+
+struct ContourPair {
+    int first; // rate index along the x axis
+    int second; // rate index along the y axis
+    string path; // output path without extension, grid l > 0 is written to path_refined<l>.csv
+};
+
+/* Grid of a single pair at one refinement level, in unit hypercube coordinates */
+struct ContourWindow {
+    double low1, high1;
+    double low2, high2;
+    MatrixXd cost; // resolution x resolution, NaN until evaluated
+};
+
+class ContourGrid{
+    public:
+        ContourGrid(CostEvaluator &costs, const RateBounds &rateBounds, int gridResolution, int nRefinements, long seed)
+            : evaluator(costs), bounds(rateBounds), resolution(gridResolution), refinements(nRefinements), baseSeed(seed) {}
+        vector<string> evaluate(const VectorXd &theta, const MatrixXd &x0, const vector<ContourPair> &pairs, const vector<string> &parameterNames);
+    private:
+        double position(double low, double high, int idx) const { return low + (high - low) * idx / resolution; }
+        string identity(const VectorXd &theta, const MatrixXd &x0, const ContourPair &pair, const vector<string> &parameterNames) const;
+        bool resume(const string &pointsFile, const string &header, vector<MatrixXd> &done);
+        ContourWindow zoom(const ContourWindow &previous) const;
+        void write(const ContourWindow &window, const ContourPair &pair, const vector<string> &parameterNames, const string &fileName) const;
+        CostEvaluator &evaluator;
+        const RateBounds &bounds;
+        int resolution;
+        int refinements;
+        long baseSeed; // per point seeds are baseSeed + task index when baseSeed > 0
+};
+
+#endif
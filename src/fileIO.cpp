@@ -1,4 +1,7 @@
 #include "fileIO.hpp"
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
 
 using namespace std;
 using Eigen::MatrixXd;
@@ -135,6 +138,7 @@ MatrixXd txtToMatrix(const string& fileName, int rows, int cols) {
 
 */
 MatrixXd csvToMatrix (const std::string & path){
+    ScopedTimer timer(IO);
     std::ifstream indata;
     indata.open(path);
     if(!indata.is_open()){
@@ -231,60 +235,77 @@ vector<MatrixXd> readY(const std::string & path){
     cout << "---------------------------" << endl;
     return Y;
 }
-/* 
-    Summary:
-        Converts a matrix mat into a csv file, defined by the string variable fileName.
- */
-void matrixToCsv(const MatrixXd& mat, const string& fileName){ // prints matrix to csv
-    std::ofstream plot;
-    string csvFile = fileName + ".csv";
-	plot.open(csvFile);
+/* Appends the shortest decimal representation of v that reads back as exactly v, std::to_chars is locale independent */
+static void appendDouble(string &buffer, double v){
+    char digits[32];
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), v);
+    buffer.append(digits, result.ptr);
+#else
+    int n = snprintf(digits, sizeof(digits), "%.17g", v);
+    buffer.append(digits, n);
+#endif
+}
 
-    for(int i = 0; i < mat.rows(); i++){
+/* Formats rows into a large buffer that is written in a few big chunks instead of streaming every double */
+static void writeCsv(const MatrixXd& mat, const vector<string> *labels, const string& fileName){
+    ScopedTimer timer(IO);
+    const size_t chunkBytes = 1 << 22;
+    std::ofstream plot(fileName + ".csv", std::ios::binary);
+    string buffer;
+    buffer.reserve(chunkBytes + 4096);
+    if(labels != nullptr){
         for(int j = 0; j < mat.cols(); j++){
-            if(j == 0){
-                plot << mat(i,j);
-            }else{
-                plot << "," << mat(i,j);
+            if(j > 0){
+                buffer.push_back(',');
             }
+            buffer += (*labels)[j];
         }
-        plot << endl;
-    }
-    plot.close();
-}
-
-void matrixToCsvWithLabels(const MatrixXd& mat,  vector<string> &labels, const string& fileName){ // prints matrix to csv
-    std::ofstream plot;
-    string csvFile = fileName + ".csv";
-	plot.open(csvFile);
-    for(int j = 0; j < mat.cols(); j++){
-        if(j == 0){
-            plot << labels[j];
-        }else{
-            plot << "," << labels[j];
-        }
+        buffer.push_back('\n');
     }
-    plot << endl;
     for(int i = 0; i < mat.rows(); i++){
         for(int j = 0; j < mat.cols(); j++){
-            if(j == 0){
-                plot << mat(i,j);
-            }else{
-                plot << "," << mat(i,j);
-            }  
+            if(j > 0){
+                buffer.push_back(',');
+            }
+            appendDouble(buffer, mat(i,j));
+        }
+        buffer.push_back('\n');
+        if(buffer.size() >= chunkBytes){
+            plot.write(buffer.data(), buffer.size());
+            buffer.clear();
         }
-        plot << endl;
     }
+    plot.write(buffer.data(), buffer.size());
     plot.close();
 }
+
+/* 
+    Summary:
+        Converts a matrix mat into a csv file, defined by the string variable fileName.
+ */
+void matrixToCsv(const MatrixXd& mat, const string& fileName){ // prints matrix to csv
+    writeCsv(mat, nullptr, fileName);
+}
+
+void matrixToCsvWithLabels(const MatrixXd& mat,  vector<string> &labels, const string& fileName){ // prints matrix to csv
+    writeCsv(mat, &labels, fileName);
+}
+/* run, steps, evaluations and seconds of every PSO run (rows of stats) with the reason it stopped */
+void writeStoppingReasons(const MatrixXd &stats, const vector<string> &reasons, const string &fileName){
+    ScopedTimer timer(IO);
+    std::ofstream out(fileName + ".csv");
+    out << "run,steps,evaluations,seconds,reason" << endl;
+    for(int i = 0; i < stats.rows(); i++){
+        out << i << "," << stats(i,0) << "," << stats(i,1) << "," << stats(i,2) << "," << reasons[i] << endl;
+    }
+    out.close();
+}
 void vectorToCsv(const VectorXd& v, const string& fileName){
-    std::ofstream plot;
-    string csvFile = fileName + ".csv";
-	plot.open(csvFile);
-    plot << v << endl;
-    plot.close();
+    writeCsv(v, nullptr, fileName); // one value per row
 }
 void reportLeastCostMoments(const VectorXd & est, const VectorXd & obs, double t, const string& fileName){
+    ScopedTimer timer(IO);
     std::ofstream plot;
     string csvFile = fileName + "t" + to_string_with_precision(t, 2)+ "_leastCostMoments.csv";
 	plot.open(csvFile);
@@ -2,7 +2,8 @@
 #define _GRAPH_HPP_
 /*
 Author: John Wu
-Summary: Functions Used to Generate Graphs. Note that every file path is essentially a vector of strings that gets read in and outputted by a python graphing script.
+Summary: Functions Used to Generate Graphs. Note that every file path is essentially a vector of strings that gets read in and outputted by a python graphing script,
+all figures of a run are collected in a manifest and drawn by a single python process.
 Python makes life easier.
  */
 
@@ -42,75 +43,76 @@ class Grapher{
             observedFile = generalPath + "_observed.csv";
         }
 
+    /* Each graph call only records the arguments of its figure, render() draws every recorded figure in a single python3 process */
     void graphMoments(int nSpecies){
-        int status = 0;
-        string whichMoments = " -m " + to_string(nSpecies);
-
         for(int i = 0; i < leastCostMoments.size(); ++i){
-            string cmd = "python3 graph.py -f " + leastCostMoments[i] + " -g Moments -n \"Fit of Predicted Moments\"" + whichMoments;
-            status = system(cmd.c_str());
-        }
-
-        if (status < 0)
-            std::cout << "Error: " << strerror(errno) << '\n';
-        else
-        {
-            if (WIFEXITED(status))
-                std::cout << "Program returned normally, exit code " << WEXITSTATUS(status) << '\n';
-            else
-                std::cout << "Program exited abnormaly\n";
+            figures.push_back({"-f", leastCostMoments[i], "-g", "Moments", "-n", "Fit of Predicted Moments", "-m", to_string(nSpecies)});
         }
     }
     void graphConfidenceIntervals(bool simulated){
-        string cmd = "python3 graph.py -f " + estFile + " -g CI";
         if(simulated){
-            cmd = "python3 graph.py -f " + estFile + " -g CI_truth -r " + trueRatesFile + " -n \"Parameter Estimates\"";
-        }
-        int status = system(cmd.c_str());
-        if (status < 0)
-            std::cout << "Error: " << strerror(errno) << '\n';
-        else
-        {
-            if (WIFEXITED(status))
-                std::cout << "Program returned normally, exit code " << WEXITSTATUS(status) << '\n';
-            else
-                std::cout << "Program exited abnormaly\n";
+            figures.push_back({"-f", estFile, "-g", "CI_truth", "-r", trueRatesFile, "-n", "Parameter Estimates"});
+        }else{
+            figures.push_back({"-f", estFile, "-g", "CI"});
         }
     }
 
     void graphForecasts(int nSpecies){
-        string whichMoments = " -m " + to_string(nSpecies);
-        string cmd = "python3 graph.py -f " + forecastFile + " " + observedFile + " -g forecast" + whichMoments;
-
-        int status = system(cmd.c_str());
-        if (status < 0)
-            std::cout << "Error: " << strerror(errno) << '\n';
-        else
-        {
-            if (WIFEXITED(status))
-                std::cout << "Program returned normally, exit code " << WEXITSTATUS(status) << '\n';
-            else
-                std::cout << "Program exited abnormaly\n";
-        }
+        figures.push_back({"-f", forecastFile, observedFile, "-g", "forecast", "-m", to_string(nSpecies)});
     }
 
     void graphContours(int nRates, const string & contourFile){
-        string whichMoments = " -m " + to_string(nRates);
-        string titleFig = " -n " + modelName;
-        string cmd = "python3 graph.py -f "+ contourFile + " -g contour" + whichMoments + titleFig;
+        figures.push_back({"-f", contourFile, "-g", "contour", "-m", to_string(nRates), "-n", modelName});
+    }
 
+    int nFigures() const { return figures.size(); }
+
+    /*
+        Summary:
+            Writes one line of arguments per recorded figure to <model>_graphs.txt and renders all of them with one python3 graph.py -batch call,
+            so python and matplotlib are only started once per program run.
+     */
+    void render(){
+        if(figures.size() == 0){
+            return;
+        }
+        ScopedTimer timer(GRAPHING);
+        string manifest = generalPath + "_graphs.txt";
+        std::ofstream out(manifest);
+        for(const vector<string> &args : figures){
+            for(int i = 0; i < args.size(); ++i){
+                out << (i == 0 ? "" : " ") << quote(args[i]);
+            }
+            out << endl;
+        }
+        out.close();
+        string cmd = "python3 graph.py -batch " + quote(manifest);
         int status = system(cmd.c_str());
         if (status < 0)
             std::cout << "Error: " << strerror(errno) << '\n';
         else
         {
             if (WIFEXITED(status))
-                std::cout << "Program returned normally, exit code " << WEXITSTATUS(status) << '\n';
+                std::cout << "Rendered " << figures.size() << " figures, exit code " << WEXITSTATUS(status) << '\n';
             else
                 std::cout << "Program exited abnormaly\n";
         }
+        figures.clear();
     }
-    
+    private:
+        vector<vector<string>> figures; // graph.py arguments of every figure waiting to be rendered
+        /* single quotes an argument for both the shell and python's shlex, so paths and titles with spaces survive */
+        static string quote(const string &arg){
+            string quoted = "'";
+            for(char c : arg){
+                if(c == '\''){
+                    quoted += "'\\''";
+                }else{
+                    quoted += c;
+                }
+            }
+            return quoted + "'";
+        }
 };
 
 
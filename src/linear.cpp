@@ -13,6 +13,7 @@
 
  */
 VectorXd momentVector(const MatrixXd &sample, int nMoments){
+    ScopedTimer timer(MOMENTS);
     VectorXd moments(nMoments);
     VectorXd mu = sample.colwise().mean();
     VectorXd variances(sample.cols());
@@ -20,6 +20,15 @@ due to something with memory or how functions work from the compiler. Also libRR
 #include "param.hpp"
 #include "cli.hpp"
 #include "graph.hpp"
+#include "profiler.hpp"
+#include "simulator.hpp"
+#include "optimize.hpp"
+#include "surrogate.hpp"
+#include "bounds.hpp"
+#include "contour.hpp"
+#include "profile.hpp"
+#include "results.hpp"
+#include "output.hpp"
 int main(int argc, char** argv){
     auto t1 = std::chrono::high_resolution_clock::now();
     /* Input Parameters for Program */
@@ -36,11 +45,13 @@ int main(int argc, char** argv){
     if(generatingSurrogate){
         fs::create_directory(parameters.outPath + "/surrogate/");
     }
+    OutputProfile outputProfile = getOutputProfile(argc, argv);
     
     /* Read time steps*/
     VectorXd times = readCsvTimeParam(getTimeStepsPath(argc, argv));
     /* Important! Max Thread Count Test */
     omp_set_num_threads(parameters.nThreads);
+    OutputQueue::instance().setAsynchronous(parameters.asyncOutput > 0);
 
     /* Read First Matrix */
     MatrixXd x0;
@@ -87,7 +98,6 @@ int main(int argc, char** argv){
     /* Solve for Y_t (mu). */
     VectorXd tru;
     vector<MatrixXd> yt3Mats;
-    vector<MatrixXd> ogYt3Mats;
     vector<VectorXd> yt3Vecs; // vector of observed moments for each time point (each element in in this vector is a vector)
     vector<MatrixXd> allMomentsAcrossTime; // we can store all moment vectors that are generated through each run in matrices for each time point.
     for(int t = 1; t < times.size();  ++t){
@@ -106,10 +116,10 @@ int main(int argc, char** argv){
             yt3Vecs.push_back(momentVector(yt3Mats[i], nMoments));
             cout << "t" << times(i+1) << " moments:"<< yt3Vecs[i].transpose() << endl;
         }
-        ogYt3Mats = yt3Mats;
     }
     /* Default Bionetgen Mode */
     vector<string> parameterNames;
+    string profilePath = parameters.outPath + "BNGMM_profile.json";
     if(parameters.useSBML > 0 || useSBML(argc, argv) > 0){
         const string bngl = ".bngl"; // suffixes for sbml/bngl file types
         const string sbml = "_sbml.xml";
@@ -118,6 +128,7 @@ int main(int argc, char** argv){
         string modelPath = getModelPath(argc, argv);
         string file_without_extension = getFileNameWithoutExtensions(modelPath);
         string sbmlModel = "sbml/"+ file_without_extension + sbml;
+        profilePath = parameters.outPath + file_without_extension + "_profile.json";
         const string bnglCall = "bionetgen run -i" + modelPath + " -o sbml";
         Grapher graph = Grapher(parameters.outPath, file_without_extension, getTrueRatesPath(argc, argv), times, parameters.nRates);
         if(system(bnglCall.c_str()) < 0 && useSBML(argc, argv) < 0){
@@ -175,7 +186,34 @@ int main(int argc, char** argv){
         }
         SimulateOptions opt;
         opt.steps = parameters.odeSteps;
-        double theta[parameters.nRates];// static array to be constantly used with road runner model parameters.
+        CellSimulator simulator(r, opt, specifiedProteins); // one model copy per thread, reused by every particle
+        RateBounds bounds(parameters.nRates, parameters.hyperCubeScale);
+        if(rateBoundsExist(argc, argv)){
+            bounds.read(getRateBoundsPath(argc, argv));
+            bounds.print();
+        }
+        if(parameters.useDet <= 0){
+            TauLeapSettings tauLeap = {parameters.useTauLeap > 0, parameters.tauEpsilon, parameters.tauCriticalCount, parameters.tauSSAThreshold, 100};
+            simulator.useSSA(netFileFromSBML(sbmlModel), vector<string>(parameterNames.begin(), parameterNames.end() - 1), speciesNames, tauLeap);
+        }
+        /* loose tolerances are used for the PSO only, Yt and the final estimates are simulated with the final ones */
+        IntegratorSettings finalIntegrator = {"cvode", parameters.finalRelTol, parameters.finalAbsTol, parameters.maxIntegratorSteps};
+        IntegratorSettings psoIntegrator = {"cvode", parameters.psoRelTol, parameters.psoAbsTol, parameters.maxIntegratorSteps};
+        if(parameters.useDet > 0){
+            if(parameters.autoIntegrator > 0){
+                VectorXd probeTheta = bounds.toRates(VectorXd::Constant(parameters.nRates, 0.5));
+                if(seedRates(argc, argv)){
+                    probeTheta = bounds.toRates(readSeed(parameters.nRates, getSeededRates(argc,argv)));
+                }else if(parameters.simulateYt > 0){
+                    probeTheta = readRates(parameters.nRates, getTrueRatesPath(argc, argv));
+                }
+                double stiffness = simulator.stiffnessRatio(probeTheta, x0.colwise().mean(), times(0), times(times.size() - 1));
+                finalIntegrator.name = stiffness > parameters.stiffnessThreshold ? "cvode" : "rk45";
+                psoIntegrator.name = finalIntegrator.name;
+                cout << "Stiffness ratio at " << probeTheta.transpose() << " is " << stiffness << ", using " << finalIntegrator.name << endl;
+            }
+            simulator.configureIntegrator(finalIntegrator);
+        }
         if(parameters.simulateYt > 0){
             cout << "------ SIMULATING YT! ------" << endl;
             tru = readRates(parameters.nRates, getTrueRatesPath(argc, argv));
@@ -187,34 +225,19 @@ int main(int argc, char** argv){
             cout << "Time Point \t\t Moments" << endl;
             for(int t = 1; t < times.size(); t++){ // start at t1, because t0 is now in the vector
                 
-                MatrixXd YtMat = MatrixXd::Zero(Y_0.rows(), Y_0.cols());
-                opt.start = times(0);
-                opt.duration = times(t);
-                for(int i = 0; i < tru.size(); ++i){
-                    theta[i] = tru(i);  
-                }
-                r.getModel()->setGlobalParameterValues(tru.size(), 0, theta); // set new global parameter values here.
-                for(int i = 0; i < Y_0.rows(); ++i){
-                    if(specifiedProteins.size() > 0){
-                        vector<double> init = r.getFloatingSpeciesInitialConcentrations();
-                        for(int p = 0; p < specifiedProteins.size(); p++){
-                            init[specifiedProteins[p]] = Y_0(i,p);
-                        } 
-                        r.changeInitialConditions(init);
-                    }else{
-                        r.changeInitialConditions(convertInit(Y_0.row(i)));
-                    }
-                    const DoubleMatrix res = *r.simulate(&opt);
-                    for(int j = 0; j < Y_0.cols(); ++j){
-                        YtMat(i,j) = res[res.numRows() - 1][j + 1];
-                    }
-                }
+                MatrixXd YtMat = simulator.simulate(tru, Y_0, times(0), times(t), gen);
                 yt3Vecs.push_back(momentVector(YtMat, nMoments));
                 yt3Mats.push_back(YtMat);
                 cout << times(t) << " "<< yt3Vecs[t-1].transpose() << endl;
             }
             cout << "--------------------------------------------------------" << endl;
         }
+        /* Common random numbers are turned on after Yt is simulated so simulated data stays independent of the fitted trajectories */
+        if(parameters.useCRN > 0 && parameters.useDet <= 0){
+            long crnSeed = parameters.seed > 0 ? parameters.seed : gen();
+            simulator.setCommonRandomNumbers(crnSeed);
+            cout << "Using common random numbers with base seed " << crnSeed << endl;
+        }
 
         MatrixXd heldTheta;
         /* HeldRates if it happens*/ 
@@ -241,12 +264,11 @@ int main(int argc, char** argv){
             cout << "--------------------------------------------------------" << endl << endl;
         }
 
+        CostEvaluator evaluator(simulator, times, yt3Vecs, weights, nMoments);
         /* Contour Function - ONLY RUNS IF SIMULATED OR IF SEEDED */
         if(contour(argc, argv) && (seedRates(argc, argv) || parameters.simulateYt > 0 )){
             cout << "--------------------------------------------------------" << endl;
             cout << "Generating Contour Files With" << endl;
-            int stepSize = 25;
-
             VectorXd contourTheta;
             if(parameters.simulateYt > 0){
                 contourTheta = tru;
@@ -254,94 +276,103 @@ int main(int argc, char** argv){
                 contourTheta = readSeed(parameters.nRates, getSeededRates(argc,argv));
             }
             cout << "Theta:" << contourTheta.transpose() << endl;
-            int fIdx = 0;
-            int sIdx = 0;
-            string fT = getContourTheta1(argc,argv);
-            string sT = getContourTheta2(argc,argv);
-            for(int param = 0; param < parameterNames.size(); ++param){
-                if(parameterNames[param] == fT){
-                    fIdx = param;
-                }else if(parameterNames[param] == sT){
-                    sIdx = param;
+            vector<string> names = getContourNames(argc, argv);
+            vector<ContourPair> pairs;
+            if(names.size() == 1 && names[0] == "all"){
+                for(int first = 0; first < parameters.nRates; ++first){
+                    for(int second = first + 1; second < parameters.nRates; ++second){
+                        pairs.push_back({first, second, ""});
+                    }
                 }
-            }
-
-            vector<string> contourLabels;
-            MatrixXd contour = MatrixXd::Zero(stepSize*stepSize, 3); // # of pairwise params x Coordinate + Cost that we will eventually convert to csv
-            MatrixXd contourGrid = MatrixXd::Zero(stepSize, stepSize);  // to store all the costs parallel wise
-            MatrixXd contourX = MatrixXd::Zero(stepSize, stepSize); // first column i.e columnwise coordinates
-            MatrixXd contourY = MatrixXd::Zero(stepSize, stepSize); // 2nd column i.e rowwise coordinates (when plotting)
-            contourLabels.push_back(parameterNames[fIdx]);
-            contourLabels.push_back(parameterNames[sIdx]);
-            contourLabels.push_back("Cost");
-                
-            #pragma omp parallel for schedule(dynamic)
-                for(int idxs = 0; idxs < stepSize; ++idxs){
-                    SimulateOptions pOpt = opt;
-                    RoadRunner paraMod = r;
-                    double firstTheta = parameters.hyperCubeScale * double(idxs) / stepSize;
-                    double pTheta[parameters.nRates];
-                    for(int jdx = 0; jdx < stepSize; ++jdx){
-                        double gmm = 0;
-                        double secondTheta = parameters.hyperCubeScale * double(jdx) / stepSize;
-                        for(int idx = 0; idx < contourTheta.size(); ++idx){
-                            pTheta[idx] = contourTheta(idx);
-                        }
-                        pTheta[fIdx] = firstTheta;
-                        pTheta[sIdx] = secondTheta;
-                        for(int t = 1; t < times.size(); t++){
-                            MatrixXd XtMat = MatrixXd::Zero(x0.rows(), x0.cols());
-                            paraMod.getModel()->setGlobalParameterValues(contourTheta.size(),0,pTheta); // set new global parameter values here.
-                            pOpt.start = times(0);
-                            pOpt.duration = times(t);
-                            for(int i = 0; i < x0.rows(); ++i){
-                                if(specifiedProteins.size() > 0){
-                                    vector<double> init = paraMod.getFloatingSpeciesInitialConcentrations();
-                                    for(int p = 0; p < specifiedProteins.size(); p++){
-                                        init[specifiedProteins[p]] = x0(i,p);
-                                    }
-                                    paraMod.changeInitialConditions(init);
-                                }else{ 
-                                    paraMod.changeInitialConditions(convertInit(x0.row(i)));
-                                }
-                                const DoubleMatrix res = *paraMod.simulate(&pOpt);
-                                for(int j = 0; j < x0.cols(); ++j){
-                                    XtMat(i,j) = res[res.numRows() - 1][j + 1];
-                                }
-                            }
-                            VectorXd XtmVec = momentVector(XtMat, nMoments);
-                            gmm += costFunction(yt3Vecs[t - 1], XtmVec, weights[t - 1]); 
-                        }
-                        contourX(idxs, jdx) = pTheta[fIdx];
-                        contourY(idxs, jdx) = pTheta[sIdx];
-                        contourGrid(idxs, jdx) = gmm;
-                        // secondTheta +=  parameters.hyperCubeScale * 1.0 / stepSize;
-                        // contour()
+            }else{
+                if(names.size() == 0 || names.size() % 2 != 0){
+                    cout << "Error, --contour expects pairs of rate constant names or \"all\"!" << endl;
+                    return EXIT_FAILURE;
+                }
+                for(int n = 0; n < names.size(); n += 2){
+                    auto fIt = std::find(parameterNames.begin(), parameterNames.end(), names[n]);
+                    auto sIt = std::find(parameterNames.begin(), parameterNames.end(), names[n + 1]);
+                    if(fIt == parameterNames.end() || sIt == parameterNames.end() || fIt == sIt){
+                        cout << "Error, " << names[n] << " and " << names[n + 1] << " are not two different rate constants of the model!" << endl;
+                        return EXIT_FAILURE;
                     }
-                    // firstTheta += parameters.hyperCubeScale * 1.0 / stepSize;
+                    pairs.push_back({int(fIt - parameterNames.begin()), int(sIt - parameterNames.begin()), ""});
                 }
-                    
-            int cdx = 0;
-            for(int i = 0; i < stepSize; ++i){
-                for(int j = 0; j < stepSize; ++j){
-                    contour(cdx,0) = contourX(i,j);
-                    contour(cdx,1) = contourY(i,j);
-                    contour(cdx,2) = contourGrid(i,j);
-                    cdx++; 
+            }
+            for(ContourPair &pair : pairs){
+                pair.path = parameters.outPath + file_without_extension + "_contour" + parameterNames[pair.first] + "_" + parameterNames[pair.second];
+            }
+            cout << pairs.size() << " pairs at resolution " << parameters.contourResolution << " with " << parameters.contourRefinements << " refinements" << endl;
+            ContourGrid grid(evaluator, bounds, parameters.contourResolution, parameters.contourRefinements, parameters.seed);
+            vector<string> contourFiles = grid.evaluate(contourTheta, x0, pairs, parameterNames);
+            for(const string &contourFile : contourFiles){
+                if(outputProfile != MINIMAL_OUTPUT){
+                    graph.graphContours(parameters.nRates, contourFile);
                 }
             }
-            matrixToCsvWithLabels(contour, contourLabels, parameters.outPath + file_without_extension + "_contour" + fT + "_" + sT);
-            graph.graphContours(parameters.nRates, parameters.outPath + file_without_extension + "_contour" + fT + "_" + sT + ".csv");
             cout << "--------------------------------------------------------" << endl;
         }
         
         /*------------ PSO SECTION ------------*/
-        for(int run = 0; run < parameters.nRuns; ++run){ // for multiple runs aka bootstrapping (for now)
-            if (run > 0 && parameters.bootstrap > 0){
-                for(int y = 0; y < yt3Mats.size(); ++y){ 
-                    weights[y] = wolfWtMat(yt3Mats[y], nMoments, parameters.useInverse > 0);
+        if(parameters.useDet > 0){
+            simulator.configureIntegrator(psoIntegrator);
+        }
+        MatrixXd stopStats = MatrixXd::Zero(parameters.nRuns, 3); // steps, evaluations and seconds of each run
+        vector<string> stopReasons(parameters.nRuns, "max steps reached");
+        MomentSurrogate surrogate(parameters.surrogatePoints, parameters.useDet > 0 ? 1e-6 : 1e-2);
+        /* rates that are not held, searched by the CMA-ES and the local refinements in unit hypercube coordinates */
+        vector<int> freeRates;
+        for(int i = 0; i < parameters.nRates; ++i){
+            if(!holdRates(argc, argv) || i >= heldTheta.rows() || heldTheta(i,0) == 0){
+                freeRates.push_back(i);
+            }
+        }
+        auto thetaFromFree = [&](const VectorXd &free){
+            VectorXd scaledPos = VectorXd::Zero(parameters.nRates);
+            for(int k = 0; k < freeRates.size(); ++k){
+                scaledPos(freeRates[k]) = bounds.toRate(freeRates[k], free(k));
+            }
+            if(holdRates(argc,argv)){
+                for(int i = 0; i < heldTheta.rows(); ++i){
+                    if (heldTheta(i,0) != 0){
+                        scaledPos(i) = heldTheta(i,1);
+                    }
                 }
             }
+            return scaledPos;
+        };
+        /* every refinement and profile evaluation draws the same random numbers, so stochastic costs are a deterministic function of the rates */
+        unsigned int refinementSeed = parameters.seed > 0 ? parameters.seed : gen();
+        Objective freeCost = [&](const VectorXd &free){
+            mt19937 fGen(refinementSeed);
+            return evaluator.cost(thetaFromFree(free), x0, fGen);
+        };
+        ResidualFunction freeResiduals = [&](const VectorXd &free){
+            mt19937 fGen(refinementSeed);
+            return evaluator.residuals(thetaFromFree(free), x0, fGen);
+        };
+        unsigned int bootstrapSeed = parameters.seed > 0 ? parameters.seed : gen(); // bootstrap samples of every run are reproducible from it
+        vector<MatrixXd> ytContributions(yt3Mats.size());
+        vector<VectorXd> ogYt3Vecs; // full data moments and weights, restored once the bootstrapped runs are done
+        vector<MatrixXd> ogWeights;
+        if(parameters.nRuns > 1 && parameters.bootstrap > 0){
+            ogYt3Vecs = yt3Vecs;
+            ogWeights = weights;
+        #pragma omp parallel for
+            for(int y = 0; y < yt3Mats.size(); ++y){
+                ytContributions[y] = momentContributions(yt3Mats[y], nMoments);
+            }
+        }
+        /* moments (and for full output the cells) of every global best are kept when it is found, so the final report does not re-simulate */
+        bool reuseMoments = parameters.useDet < 1; // deterministic estimates are re-simulated at the tighter final integrator tolerances
+        bool retainCells = reuseMoments && outputProfile == FULL_OUTPUT;
+        MatrixXd runMoments = MatrixXd::Zero(parameters.nRuns, evaluator.nStackedMoments()); // global best moments of each run
+        vector<MatrixXd> leastCostCells; // cells of the least cost run at every time point
+        int leastCostRun = -1;
+        double leastRunCost = std::numeric_limits<double>::infinity();
+        for(int run = 0; run < parameters.nRuns; ++run){ // for multiple runs aka bootstrapping (for now)
+            auto runStart = std::chrono::steady_clock::now();
+            surrogate.clear(); // bootstrapped data changes the moments
             // make sure to reset GBMAT, POSMAT, AND PBMAT every run
             // sfe is the pInertia wt
             //  sfp ~ particle best
@@ -358,7 +389,7 @@ int main(int argc, char** argv){
             if(holdRates(argc,argv)){
                 for(int i = 0; i < heldTheta.rows(); ++i){
                     if (heldTheta(i,0) != 0){
-                        seed(i) = heldTheta(i,1);
+                        seed(i) = bounds.toPosition(i, heldTheta(i,1));
                     }
                 }
             }
@@ -366,40 +397,28 @@ int main(int argc, char** argv){
                 seed = readSeed(parameters.nRates, getSeededRates(argc,argv));
             }
             
-            /* Evolve initial Global Best and Calculate a Cost*/
-            double costSeedK = 0;
-            for(int i = 0; i < seed.size(); ++i){
-                theta[i] = parameters.hyperCubeScale * seed(i);
+            /* Multi fidelity, early steps simulate a random subsample of the cells */
+            vector<int> cellOrder(x0.rows());
+            std::iota(cellOrder.begin(), cellOrder.end(), 0);
+            std::shuffle(cellOrder.begin(), cellOrder.end(), gen);
+            double fraction = parameters.multiFidelity > 0 ? cellFraction(0, parameters.nSteps, parameters.initialCellFraction, parameters.fullFidelityAt) : 1;
+            MatrixXd xFidelity = subsampleRows(x0, cellOrder, fraction);
+            if(fraction < 1){
+                cout << "Multi fidelity PSO, simulating " << xFidelity.rows() << " of " << x0.rows() << " cells" << endl;
             }
-            r.getModel()->setGlobalParameterValues(seed.size(),0,theta); // set new global parameter values here.
 
-            for(int t = 1; t < times.size(); t++){
-                MatrixXd XtMat = MatrixXd::Zero(x0.rows(), x0.cols());
-                opt.start = times(0);
-                opt.duration = times(t);
-                for(int i = 0; i < x0.rows(); ++i){
-                    if(specifiedProteins.size() > 0){
-                        vector<double> init = r.getFloatingSpeciesInitialConcentrations();
-                        for(int p = 0; p < specifiedProteins.size(); p++){
-                            init[specifiedProteins[p]] = x0(i,p);
-                        }
-                        r.changeInitialConditions(init);
-                    }else{ 
-                        r.changeInitialConditions(convertInit(x0.row(i)));
-                    }
-                    const DoubleMatrix res = *r.simulate(&opt);
-                    for(int j = 0; j < x0.cols(); ++j){
-                        XtMat(i,j) = res[res.numRows() - 1][j + 1];
-                    }
-                }
-                VectorXd XtmVec = momentVector(XtMat, nMoments);
-                costSeedK += costFunction(yt3Vecs[t - 1], XtmVec, weights[t - 1]); 
-            }
+            /* Evolve initial Global Best and Calculate a Cost*/
+            VectorXd scaledSeed = bounds.toRates(seed);
+            VectorXd gbMoments;
+            vector<MatrixXd> gbCells;
+            bool gbKnown = true; // false once the global best was found by an optimizer that does not report moments
+            double costSeedK = evaluator.cost(scaledSeed, xFidelity, gen, &gbMoments, std::numeric_limits<double>::infinity(), retainCells ? &gbCells : nullptr);
+            long evaluations = 1;
             cout << "PSO Seeded At:"<< seed.transpose() << "| cost:" << costSeedK << endl;
             
             double gCost = costSeedK; //initialize costs and GBMAT
             VectorXd GBVEC = seed;
-            VectorXd scaledGBVEC = parameters.hyperCubeScale * GBVEC;
+            VectorXd scaledGBVEC = bounds.toRates(GBVEC);
             
             GBMAT.conservativeResize(GBMAT.rows() + 1, parameters.nRates + 1);
             for (int i = 0; i < parameters.nRates; i++) {
@@ -411,8 +430,91 @@ int main(int argc, char** argv){
             
            
             cout << "PSO Estimation Has Begun, This may take some time..." << endl;
-            for(int step = 0; step < parameters.nSteps; step++){
+            /* CMA-ES replaces the PSO steps but keeps the seed, bounds, held rates, stopping rules and outputs */
+            int psoSteps = parameters.nSteps;
+            if(parameters.optimizer == 1 && freeRates.size() > 0){
+                psoSteps = 0;
+                if(fraction < 1){ // the seed was costed on the subsampled cells, CMA-ES and the refinements cost all of them
+                    gCost = evaluator.cost(scaledGBVEC, x0, gen, &gbMoments, std::numeric_limits<double>::infinity(), retainCells ? &gbCells : nullptr);
+                    GBMAT(GBMAT.rows() - 1, parameters.nRates) = gCost;
+                    evaluations++;
+                }
+                fraction = 1;
+                VectorXd freeSeed(freeRates.size());
+                for(int k = 0; k < freeRates.size(); ++k){
+                    freeSeed(k) = seed(freeRates[k]);
+                }
+                CMAESSettings cma = {parameters.cmaPopulation, parameters.nSteps, parameters.cmaSigma, (unsigned int) (parameters.seed > 0 ? parameters.seed + run : gen())};
+                int generation = 0;
+                GenerationCallback afterGeneration = [&](const MatrixXd &population, const VectorXd &best, double bestCost){
+                    generation++;
+                    evaluations += population.cols();
+                    VectorXd bestTheta = thetaFromFree(best);
+                    GBMAT.conservativeResize(GBMAT.rows() + 1, parameters.nRates + 1);
+                    for (int i = 0; i < parameters.nRates; i++) {GBMAT(GBMAT.rows() - 1, i) = bestTheta(i);}
+                    GBMAT(GBMAT.rows() - 1, parameters.nRates) = bestCost;
+                    std::chrono::duration<double> runTime = std::chrono::steady_clock::now() - runStart;
+                    stopStats(run, 0) = generation;
+                    stopStats(run, 1) = evaluations;
+                    stopStats(run, 2) = runTime.count();
+                    string reason = stoppingReason(parameters.stopping, GBMAT, population.transpose(), runTime.count(), evaluations);
+                    if(reason != ""){
+                        stopReasons[run] = reason;
+                        cout << "Stopping run " << run << " after " << generation << " generations: " << reason << endl;
+                    }
+                    return reason != "";
+                };
+                RefinementResult result = cmaes(freeCost, freeSeed, cma, afterGeneration);
+                if(result.cost < gCost){
+                    for(int k = 0; k < freeRates.size(); ++k){
+                        GBVEC(freeRates[k]) = result.position(k);
+                    }
+                    scaledGBVEC = thetaFromFree(result.position);
+                    gCost = result.cost;
+                    gbKnown = false;
+                }
+            }
+            for(int step = 0; step < psoSteps; step++){
+                auto stepStart = std::chrono::steady_clock::now();
+                long stepStartEvaluations = evaluations;
                 MatrixXd surrogateData = MatrixXd::Zero(parameters.nParts, nMoments);
+                long pruned = 0; // evaluations terminated early
+                long screened = 0; // evaluations skipped by the surrogate
+                double stepFraction = parameters.multiFidelity > 0 ? cellFraction(step, parameters.nSteps, parameters.initialCellFraction, parameters.fullFidelityAt) : 1;
+                if(stepFraction != fraction){
+                    fraction = stepFraction;
+                    xFidelity = subsampleRows(x0, cellOrder, fraction);
+                    cout << "Step " << step << ": simulating " << xFidelity.rows() << " of " << x0.rows() << " cells" << endl;
+                    surrogate.clear(); // moments of fewer cells are noisier and would bias its predictions at the new fidelity
+                    /* costs at different fidelities are not comparable, re-evaluate the particle and global bests */
+                #pragma omp parallel for schedule(dynamic)
+                    for(int particle = 0; particle < parameters.nParts; particle++){
+                        random_device pRanDev;
+                        mt19937 pGen(pRanDev());
+                        if(parameters.seed > 0){
+                            pGen.seed(particle + step + parameters.seed);
+                        }
+                        VectorXd scaledPB = bounds.toRates(PBMAT.row(particle).head(parameters.nRates));
+                        if(holdRates(argc,argv)){
+                            for(int i = 0; i < heldTheta.rows(); ++i){
+                                if (heldTheta(i,0) != 0){
+                                    scaledPB(i) = heldTheta(i,1);
+                                }
+                            }
+                        }
+                        PBMAT(particle, parameters.nRates) = evaluator.cost(scaledPB, xFidelity, pGen);
+                    }
+                    gCost = evaluator.cost(scaledGBVEC, xFidelity, gen, &gbMoments, std::numeric_limits<double>::infinity(), retainCells ? &gbCells : nullptr);
+                    evaluations += parameters.nParts + 1;
+                    for(int particle = 0; particle < parameters.nParts; particle++){
+                        if(PBMAT(particle, parameters.nRates) < gCost){
+                            gCost = PBMAT(particle, parameters.nRates);
+                            GBVEC = PBMAT.row(particle).head(parameters.nRates);
+                            scaledGBVEC = bounds.toRates(GBVEC);
+                            gbKnown = false;
+                        }
+                    }
+                }
             #pragma omp parallel for schedule(dynamic)
                 for(int particle = 0; particle < parameters.nParts; particle++){
                     /* initialize all particle rate constants with unifDist */
@@ -425,14 +527,11 @@ int main(int argc, char** argv){
                         pGen.seed(pSeed);
                     }
                     VectorXd scaledPos = VectorXd::Zero(parameters.nRates);
-                    RoadRunner paraModel = r;
-                    SimulateOptions pOpt = opt;
-                    double parallelTheta[parameters.nRates];
                     if(step == 0){
                         /* initialize all particles with random rate constant positions */
                         for(int i = 0; i < parameters.nRates; i++){
                             POSMAT(particle, i) = pUnifDist(pGen);
-                            scaledPos(i)= parameters.hyperCubeScale * POSMAT(particle,i);
+                            scaledPos(i) = bounds.toRate(i, POSMAT(particle,i));
                         }
 
                         if(holdRates(argc,argv)){
@@ -443,36 +542,14 @@ int main(int argc, char** argv){
                             }
                         }
                         
-                        double cost = 0;    
-                        for(int i = 0; i < parameters.nRates; ++i){
-                            parallelTheta[i] = scaledPos(i);
+                        VectorXd moments;
+                        double cost = evaluator.cost(scaledPos, xFidelity, pGen, &moments);
+                        if(generatingSurrogate){
+                            surrogateData.row(particle) = moments.tail(nMoments);
                         }
-                        paraModel.getModel()->setGlobalParameterValues(parameters.nRates,0, parallelTheta); // set new global parameter values here.
-                        for(int t = 1; t < times.size(); ++t){
-                            MatrixXd XtMat = MatrixXd::Zero(x0.rows(), x0.cols());
-                            pOpt.start = times(0);
-                            pOpt.duration = times(t);                   
-                            for(int i = 0; i < x0.rows(); ++i){
-                                if(specifiedProteins.size() > 0){
-                                    vector<double> init = paraModel.getFloatingSpeciesInitialConcentrations();
-                                    for(int p = 0; p < specifiedProteins.size(); p++){
-                                        init[specifiedProteins[p]] = x0(i,p);
-                                    }
-                                    paraModel.changeInitialConditions(init);
-                                }else{
-                                    paraModel.changeInitialConditions(convertInit(x0.row(i)));
-                                }
-                                const DoubleMatrix res = *paraModel.simulate(&pOpt);
-                                for(int j = 0; j < x0.cols(); ++j){
-                                    XtMat(i,j) = res[res.numRows() - 1][j + 1];
-                                }
-                            }
-                            VectorXd XtmVec = momentVector(XtMat, nMoments);
-                            if(generatingSurrogate){
-                                surrogateData.row(particle) = XtmVec;
-                            }
-                            
-                            cost += costFunction(yt3Vecs[t - 1], XtmVec, weights[t - 1]); 
+                        if(parameters.surrogateScreening > 0){
+                        #pragma omp critical
+                            surrogate.add(POSMAT.row(particle), moments);
                         }
                         
                         /* instantiate PBMAT */
@@ -490,7 +567,7 @@ int main(int argc, char** argv){
                         VectorXd PBVEC(parameters.nRates);
                         for(int i = 0; i < parameters.nRates; ++i){PBVEC(i) = PBMAT(particle, i);}
                         POSMAT.row(particle) = (w1 * rpoint + w2 * PBVEC + w3 * GBVEC); // update position of particle
-                        scaledPos = parameters.hyperCubeScale*POSMAT.row(particle);
+                        scaledPos = bounds.toRates(POSMAT.row(particle));
                         if(holdRates(argc,argv)){
                             for(int i = 0; i < heldTheta.rows(); ++i){
                                 if (heldTheta(i,0) != 0){
@@ -499,47 +576,40 @@ int main(int argc, char** argv){
                             }
                         }
                         // if(holdRates(argc, argv)){POSMAT.row(particle)(parameters.heldTheta) = parameters.heldThetaVal;}
-                        double cost = 0;
-                    
-                        for(int t = 1; t < times.size(); ++t){ 
-                            MatrixXd XtMat = MatrixXd::Zero(x0.rows(), x0.cols());
-                            // RoadRunner paraModel = r;
-                            // double parallelTheta[parameters.nRates];
-                            for(int i = 0; i < parameters.nRates; ++i){
-                                parallelTheta[i] = scaledPos(i);
-                            }
-                            paraModel.getModel()->setGlobalParameterValues(parameters.nRates,0, parallelTheta); // set new global parameter values here.
-                            // SimulateOptions pOpt = opt;
-                            pOpt.start = times(0);
-                            pOpt.duration = times(t);                   
-                            for(int i = 0; i < x0.rows(); ++i){
-                                if(specifiedProteins.size() > 0){
-                                    vector<double> init = paraModel.getFloatingSpeciesInitialConcentrations();
-                                    for(int p = 0; p < specifiedProteins.size(); p++){
-                                        init[specifiedProteins[p]] = x0(i,p);
-                                    }
-                                    paraModel.changeInitialConditions(init);
-                                }else{
-                                    paraModel.changeInitialConditions(convertInit(x0.row(i)));
-                                }
-                                const DoubleMatrix res = *paraModel.simulate(&pOpt);
-                                for(int j = 0; j < x0.cols(); ++j){
-                                    XtMat(i,j) = res[res.numRows() - 1][j + 1];
-                                }
-                            }
-                            VectorXd XtmVec = momentVector(XtMat, nMoments);
-                            if(generatingSurrogate){
-                                surrogateData.row(particle) = XtmVec;
-                            }
-                            cost += costFunction(yt3Vecs[t - 1], XtmVec, weights[t - 1]);   
+                        /* surrogate data needs the moments of every time point, so particles are only pruned when not generating it */
+                        double bound = std::numeric_limits<double>::infinity();
+                        if(parameters.earlyTermination > 0 && !generatingSurrogate){
+                            bound = PBMAT(particle, parameters.nRates);
+                        }
+                        /* skip particles the surrogate confidently predicts will not improve their personal best */
+                        bool simulateParticle = true;
+                        if(parameters.surrogateScreening > 0 && surrogate.ready() && !generatingSurrogate){
+                            double relativeVariance = 1;
+                            VectorXd predicted = surrogate.predict(POSMAT.row(particle), relativeVariance);
+                            simulateParticle = relativeVariance > parameters.surrogateConfidence || evaluator.costFromMoments(predicted) < PBMAT(particle, parameters.nRates);
+                        }
+                        VectorXd moments;
+                        vector<MatrixXd> cells;
+                        double cost = std::numeric_limits<double>::infinity();
+                        if(simulateParticle){
+                            cost = evaluator.cost(scaledPos, xFidelity, pGen, &moments, bound, retainCells ? &cells : nullptr);
+                        }else{
+                        #pragma omp atomic
+                            screened++;
+                        }
+                        if(generatingSurrogate){
+                            surrogateData.row(particle) = moments.tail(nMoments);
+                        }
+                        if(simulateParticle && cost > bound){
+                        #pragma omp atomic
+                            pruned++;
                         }
                     
                         /* update gBest and pBest */
                     #pragma omp critical
                     {   
-                        if(generatingSurrogate){
-                            cout << "SURROGATE DATA GENERATION!!!" << endl;
-                            writeSurrogate(POSMAT, surrogateData, parameters.outPath + "/surrogate/" + file_without_extension + "_step" + to_string(step));
+                        if(parameters.surrogateScreening > 0 && simulateParticle && cost <= bound){
+                            surrogate.add(POSMAT.row(particle), moments);
                         }
                         if(cost < PBMAT(particle, parameters.nRates)){ // particle best cost
                             for(int i = 0; i < parameters.nRates; i++){
@@ -549,17 +619,70 @@ int main(int argc, char** argv){
                             if(cost < gCost){
                                 gCost = cost;
                                 GBVEC = POSMAT.row(particle);
-                                scaledGBVEC = parameters.hyperCubeScale * GBVEC;
+                                scaledGBVEC = bounds.toRates(GBVEC);
+                                gbMoments = moments;
+                                gbCells = std::move(cells);
+                                gbKnown = true;
                             }   
                         }
                     }
                     }
                 }
+                if(generatingSurrogate){ // written once per step by the output queue while the next step runs
+                    cout << "SURROGATE DATA GENERATION!!!" << endl;
+                    string surrogateFile = parameters.outPath + "/surrogate/" + file_without_extension + "_step" + to_string(step);
+                    OutputQueue::instance().submit([positions = POSMAT, surrogateData, surrogateFile]() mutable { writeSurrogate(positions, surrogateData, surrogateFile); });
+                }
                 GBMAT.conservativeResize(GBMAT.rows() + 1, parameters.nRates + 1); // Add to GBMAT after resizing
                 for (int i = 0; i < parameters.nRates; i++) {GBMAT(GBMAT.rows() - 1, i) = scaledGBVEC(i);} // ideally want to save scaled version
                 GBMAT(GBMAT.rows() - 1, parameters.nRates) = gCost;
                 sfi = sfi - (sfe - sfg) / parameters.nSteps;   // reduce the inertial weight after each step 
                 sfs = sfs + (sfe - sfg) / parameters.nSteps;
+                if(parameters.earlyTermination > 0 && step > 0){
+                    cout << "Step " << step << ": terminated " << pruned << " of " << parameters.nParts << " evaluations early" << endl;
+                }
+                if(parameters.surrogateScreening > 0){
+                    if(step > 0){
+                        cout << "Step " << step << ": surrogate skipped " << screened << " of " << parameters.nParts << " evaluations" << endl;
+                    }
+                    surrogate.fit();
+                }
+                std::chrono::duration<double> stepTime = std::chrono::steady_clock::now() - stepStart;
+                evaluations += parameters.nParts - screened;
+                Profiler::instance().recordStep(run, step, evaluations - stepStartEvaluations, stepTime.count()); // includes re-evaluations after a fidelity change
+                std::chrono::duration<double> runTime = std::chrono::steady_clock::now() - runStart;
+                stopStats(run, 0) = step + 1;
+                stopStats(run, 1) = evaluations;
+                stopStats(run, 2) = runTime.count();
+                string reason = stoppingReason(parameters.stopping, GBMAT, POSMAT, runTime.count(), evaluations);
+                if(reason != ""){
+                    stopReasons[run] = reason;
+                    cout << "Stopping run " << run << " after " << step + 1 << " steps: " << reason << endl;
+                    break;
+                }
+            }
+            if(fraction < 1){ // the reported cost of a run is always on the full data
+                gCost = evaluator.cost(scaledGBVEC, x0, gen, &gbMoments, std::numeric_limits<double>::infinity(), retainCells ? &gbCells : nullptr);
+            }
+            /* local refinement of the global best, held rates stay fixed */
+            if(parameters.refinement != NO_REFINEMENT && freeRates.size() > 0){
+                VectorXd freeStart(freeRates.size());
+                for(int k = 0; k < freeRates.size(); ++k){
+                    freeStart(k) = GBVEC(freeRates[k]);
+                }
+                RefinementResult refined = refine(parameters.refinement, freeCost, freeResiduals, freeStart, gCost, parameters.refinementBudget);
+                cout << "Local refinement used " << refined.evaluations << " evaluations, cost " << gCost << " -> " << refined.cost << endl;
+                if(refined.cost < gCost){
+                    for(int k = 0; k < freeRates.size(); ++k){
+                        GBVEC(freeRates[k]) = refined.position(k);
+                    }
+                    scaledGBVEC = thetaFromFree(refined.position);
+                    gCost = refined.cost;
+                    gbKnown = false;
+                }
+            }
+            if(reuseMoments && !gbKnown){ // one evaluation instead of re-simulating the run for the report
+                evaluator.cost(scaledGBVEC, x0, gen, &gbMoments, std::numeric_limits<double>::infinity(), retainCells ? &gbCells : nullptr);
             }
             cout << "----------------PSO Best Each Iterations----------------" << endl;
             cout << GBMAT << endl;
@@ -570,19 +693,42 @@ int main(int argc, char** argv){
                 GBVECS(run, i) = scaledGBVEC(i); // or is now something scaled to GBVEC. 
             }
             GBVECS(run, parameters.nRates) = gCost;
+            if(reuseMoments){
+                runMoments.row(run) = gbMoments;
+                if(retainCells && gCost < leastRunCost){
+                    leastRunCost = gCost;
+                    leastCostRun = run;
+                    leastCostCells = std::move(gbCells);
+                }
+            }
             cout << GBVECS.row(run) << endl;
             cout << "--------------------------------------------------------" << endl;
-            /* bootstrap X0 and Y matrices if more than 1 run is specified */
-            if(parameters.nRuns > 1 && parameters.bootstrap > 0){
-                x0 = bootStrap(ogx0);
-                for(int y = 0; y < yt3Mats.size(); ++y){
-                    yt3Mats[y] = bootStrap(ogYt3Mats[y]);
-                    yt3Vecs[y] = momentVector(yt3Mats[y], nMoments);
+            /* bootstrap X0 and Y matrices for the next run if more than 1 run is specified */
+            if(run + 1 < parameters.nRuns && parameters.bootstrap > 0){
+                /* stream 0 resamples X, stream y + 1 resamples the Y of time point y, Y moments and weights are weighted sums over the cached contributions */
+            #pragma omp parallel for schedule(dynamic)
+                for(int stream = 0; stream <= yt3Mats.size(); ++stream){
+                    mt19937 bGen = bootstrapGenerator(bootstrapSeed, run + 1, stream);
+                    if(stream == 0){
+                        x0 = resampleRows(ogx0, bootstrapCounts(ogx0.rows(), bGen));
+                    }else{
+                        VectorXd counts = bootstrapCounts(yt3Mats[stream - 1].rows(), bGen);
+                        bootstrapMoments(ytContributions[stream - 1], counts, ogx0.cols(), parameters.useInverse > 0, yt3Vecs[stream - 1], weights[stream - 1]);
+                    }
                 }
-                cout << "bootstrap means" << endl << "x0:" << x0.colwise().mean() << endl << "Yt:" << yt3Mats[0].colwise().mean() << endl;
+                cout << "bootstrap means" << endl << "x0:" << x0.colwise().mean() << endl << "Yt:" << yt3Vecs[0].head(x0.cols()).transpose() << endl;
             }
 
         } // run loop
+        if(parameters.nRuns > 1 && parameters.bootstrap > 0){ // profiles and the final report are against the full data
+            x0 = ogx0;
+            yt3Vecs = ogYt3Vecs;
+            weights = ogWeights;
+        }
+        writeStoppingReasons(stopStats, stopReasons, parameters.outPath + file_without_extension + "_stopping");
+        if(parameters.useDet > 0){
+            simulator.configureIntegrator(finalIntegrator);
+        }
 
         VectorXd leastCostRunPos = VectorXd::Zero(parameters.nRates);
         int indexOfLeastCost = 0;
@@ -597,87 +743,129 @@ int main(int argc, char** argv){
             leastCostRunPos(i) = GBVECS(indexOfLeastCost, i);
         }
         
-        vectorToCsv(leastCostRunPos, parameters.outPath + file_without_extension + "_leastCostEstimate");
-        for(int t = 1; t < times.size(); ++t){
-            MatrixXd XtMat = MatrixXd::Zero(x0.rows(), x0.cols());
-            for(int i = 0; i < leastCostRunPos.size(); ++i){
-                theta[i] = leastCostRunPos(i);
-            }
-            r.getModel()->setGlobalParameterValues(leastCostRunPos.size(),0,theta); // set new global parameter values here.
-            opt.start = times(0);
-            opt.duration = times(t);
-            for(int i = 0; i < x0.rows(); ++i){
-                if(specifiedProteins.size() > 0){
-                    vector<double> init = r.getFloatingSpeciesInitialConcentrations();
-                    for(int p = 0; p < specifiedProteins.size(); p++){
-                        init[specifiedProteins[p]] = x0(i,p);
-                    }
-                    r.changeInitialConditions(init);
-                }else{    
-                    r.changeInitialConditions(convertInit(x0.row(i)));
+        /* every result array goes into one binary container, the per array csv files are only written when exporting csv */
+        ResultStore results(parameters.outPath + file_without_extension, parameters.exportCsv > 0);
+        results.setMetadata("model", modelPath);
+        results.setMetadata("rates", to_string(parameters.nRates));
+        results.setMetadata("species", to_string(x0.cols()));
+        results.setMetadata("moments", to_string(nMoments));
+        results.setMetadata("cells", to_string(x0.rows()));
+        results.setMetadata("runs", to_string(parameters.nRuns));
+        results.setMetadata("particles", to_string(parameters.nParts));
+        results.setMetadata("steps", to_string(parameters.nSteps));
+        results.setMetadata("seed", to_string(parameters.seed));
+        std::ostringstream timeList;
+        timeList << times.transpose();
+        results.setMetadata("times", timeList.str());
+        results.add("_leastCostEstimate", leastCostRunPos);
+
+        /* Profile likelihood intervals, Y cells times the cost increase is compared against the 95% quantile of a chi squared with 1 degree of freedom */
+        if(parameters.profileLikelihood > 0 && freeRates.size() > 0){
+            cout << "--------------- Profile Likelihood Intervals ---------------" << endl;
+            VectorXd bestPos = bounds.toPositions(leastCostRunPos);
+            VectorXd freeBest(freeRates.size());
+            for(int k = 0; k < freeRates.size(); ++k){
+                freeBest(k) = bestPos(freeRates[k]);
+            }
+            ProfileSettings profiling = {parameters.profilePoints, parameters.profileWidth, parameters.profileBudget, parameters.refinement != NO_REFINEMENT ? parameters.refinement : NELDER_MEAD};
+            vector<Profile> profiles = profileLikelihood(freeCost, freeResiduals, freeBest, profiling);
+            double bestCost = freeCost(freeBest);
+            for(const Profile &profile : profiles){
+                bestCost = std::min(bestCost, profile.costs.minCoeff());
+            }
+            boost::math::chi_squared chiSquared(1);
+            double threshold = boost::math::quantile(chiSquared, 0.95) / yt3Mats[0].rows();
+            vector<string> profileLabels = {"rate", "cost"};
+            profileLabels.insert(profileLabels.end(), parameterNames.begin(), parameterNames.end());
+            MatrixXd profileTable = MatrixXd::Zero(0, parameters.nRates + 2);
+            for(int k = 0; k < freeRates.size(); ++k){
+                const Profile &profile = profiles[k];
+                for(int p = 0; p < profile.costs.size(); ++p){
+                    VectorXd theta = thetaFromFree(profile.optima.row(p));
+                    profileTable.conservativeResize(profileTable.rows() + 1, parameters.nRates + 2);
+                    profileTable(profileTable.rows() - 1, 0) = freeRates[k];
+                    profileTable(profileTable.rows() - 1, 1) = profile.costs(p);
+                    profileTable.row(profileTable.rows() - 1).tail(parameters.nRates) = theta;
                 }
-                const DoubleMatrix res = *r.simulate(&opt);
-                for(int j = 0; j < x0.cols(); ++j){
-                    XtMat(i,j) = res[res.numRows() - 1][j + 1];
+                double lower = 0, upper = 0;
+                bool closed = profileInterval(profile, bestCost, threshold, lower, upper);
+                cout << parameterNames[freeRates[k]] << ": [" << bounds.toRate(freeRates[k], lower) << "," << bounds.toRate(freeRates[k], upper) << "]";
+                if(!closed){
+                    cout << " (not identifiable within the profiled range)";
                 }
+                cout << endl;
             }
-            VectorXd XtmVec = momentVector(XtMat, nMoments);
-            xt3Mats.push_back(XtMat);    
-            reportLeastCostMoments(XtmVec,yt3Vecs[t-1],times(t), parameters.outPath + file_without_extension); // FIND BEST FIT.
-            if(parameters.reportMoments > 0){
-                cout << "--------------------------------------------------------" << endl;
-                cout << "For Least Cost Estimate:" << leastCostRunPos.transpose() << endl;
-                cout << "RSS (NOT GMM) COST FROM DATASET:" << costFunction(XtmVec, yt3Vecs[t-1], MatrixXd::Identity(nMoments, nMoments)) << endl;
-                cout << "t                  moments" << endl;
-                cout << times(t) << " " << XtmVec.transpose() << endl;
-                cout << "--------------------------------------------------------" << endl;
-            }
+            results.add("_profiles", profileTable, profileLabels);
+            cout << "------------------------------------------------------------" << endl;
         }
-
-        for(int n = 0; n < GBVECS.rows(); ++n ){
+        /* the minimal profile skips re-simulating the estimates, the cell matrices of every time point are only kept for full output */
+        if(outputProfile != MINIMAL_OUTPUT){
+            bool fullDataRun = parameters.nRuns < 2 || parameters.bootstrap <= 0 || indexOfLeastCost == 0; // later runs were fitted to a bootstrapped X
+            bool reuseRunMoments = reuseMoments && fullDataRun;
+            bool reuseCells = retainCells && fullDataRun && leastCostRun == indexOfLeastCost && leastCostCells.size() + 1 == times.size();
             for(int t = 1; t < times.size(); ++t){
-                MatrixXd XtMat = MatrixXd::Zero(x0.rows(), x0.cols());
-                for(int j = 0; j < GBVECS.cols() - 1; ++j){
-                    theta[j] = GBVECS(n,j);
-                }
-                r.getModel()->setGlobalParameterValues(leastCostRunPos.size(),0,theta); // set new global parameter values here.
-                opt.start = times(0);
-                opt.duration = times(t);
-                for(int i = 0; i < x0.rows(); ++i){
-                    if(specifiedProteins.size() > 0){
-                        vector<double> init = r.getFloatingSpeciesInitialConcentrations();
-                        for(int p = 0; p < specifiedProteins.size(); p++){
-                            init[specifiedProteins[p]] = x0(i,p);
-                        }
-                        r.changeInitialConditions(init);
-                    }else{    
-                        r.changeInitialConditions(convertInit(x0.row(i)));
+                VectorXd XtmVec;
+                if(reuseCells){
+                    XtmVec = runMoments.row(indexOfLeastCost).segment(nMoments * (t - 1), nMoments).transpose();
+                    xt3Mats.push_back(leastCostCells[t-1]);
+                }else if(reuseRunMoments && outputProfile != FULL_OUTPUT){
+                    XtmVec = runMoments.row(indexOfLeastCost).segment(nMoments * (t - 1), nMoments).transpose();
+                }else{ // the reported moments always come from the same cells that are written out
+                    MatrixXd XtMat = simulator.simulate(leastCostRunPos, x0, times(0), times(t), gen);
+                    XtmVec = momentVector(XtMat, nMoments);
+                    if(outputProfile == FULL_OUTPUT){
+                        xt3Mats.push_back(XtMat);
                     }
-                    const DoubleMatrix res = *r.simulate(&opt);
-                    for(int j = 0; j < x0.cols(); ++j){
-                        XtMat(i,j) = res[res.numRows() - 1][j + 1];
+                }
+                MatrixXd leastCostMoments(nMoments, 2);
+                leastCostMoments << XtmVec, yt3Vecs[t-1]; // FIND BEST FIT.
+                results.add("t" + to_string_with_precision(times(t), 2) + "_leastCostMoments", leastCostMoments, {"Estimated", "Observed"});
+                if(parameters.reportMoments > 0){
+                    cout << "--------------------------------------------------------" << endl;
+                    cout << "For Least Cost Estimate:" << leastCostRunPos.transpose() << endl;
+                    cout << "RSS (NOT GMM) COST FROM DATASET:" << costFunction(XtmVec, yt3Vecs[t-1], MatrixXd::Identity(nMoments, nMoments)) << endl;
+                    cout << "t                  moments" << endl;
+                    cout << times(t) << " " << XtmVec.transpose() << endl;
+                    cout << "--------------------------------------------------------" << endl;
+                }
+            }
+
+            for(int n = 0; n < GBVECS.rows(); ++n ){
+                for(int t = 1; t < times.size(); ++t){
+                    if(reuseMoments){
+                        allMomentsAcrossTime[t-1].row(n) = runMoments.row(n).segment(nMoments * (t - 1), nMoments);
+                        continue;
                     }
+                    VectorXd runTheta = GBVECS.row(n).head(parameters.nRates);
+                    MatrixXd XtMat = simulator.simulate(runTheta, x0, times(0), times(t), gen);
+                    VectorXd XtmVec = momentVector(XtMat, nMoments);
+                    allMomentsAcrossTime[t-1].row(n) = XtmVec; 
                 }
-                VectorXd XtmVec = momentVector(XtMat, nMoments);
-                allMomentsAcrossTime[t-1].row(n) = XtmVec; 
             }
-        }
 
-        /* Save Data for Plotting */
-        reportAllMoments(allMomentsAcrossTime,yt3Vecs,times, parameters.outPath + file_without_extension);
-        for(int y = 0; y < yt3Mats.size(); ++y){ 
-            matrixToCsvWithLabels(yt3Mats[y], speciesNames, parameters.outPath + file_without_extension + "Yt" + to_string_with_precision(times(y + 1), 2));
+            /* Save Data for Plotting */
+            for(int t = 1; t < times.size(); t++){
+                results.add("XtMoments" + to_string_with_precision(times(t), 2), allMomentsAcrossTime[t-1]);
+                results.add("YtMoments" + to_string_with_precision(times(t), 2), yt3Vecs[t-1]);
+            }
         }
-        for(int t = 1; t < times.size(); t++){
-            matrixToCsvWithLabels(xt3Mats[t-1], speciesNames, parameters.outPath + file_without_extension + "Xt" + to_string_with_precision(times(t),2));
+        if(outputProfile == FULL_OUTPUT){
+            for(int y = 0; y < yt3Mats.size(); ++y){ 
+                results.add("Yt" + to_string_with_precision(times(y + 1), 2), yt3Mats[y], speciesNames);
+            }
+            for(int t = 1; t < times.size(); t++){
+                results.add("Xt" + to_string_with_precision(times(t), 2), xt3Mats[t-1], speciesNames);
+            }
         }
-        matrixToCsvWithLabels(GBVECS, parameterNames, parameters.outPath + file_without_extension + "_estimates");
+        results.add("_estimates", GBVECS, parameterNames);
 
         // Graphing Time
-        /* Necessary Graphing Initialization */
-        cout << "Plotting R^2 Plot and Confidence Intervals!" << endl;
-        graph.graphMoments(xt3Mats[0].cols());
-        graph.graphConfidenceIntervals(parameters.simulateYt > 0 );
+        /* Necessary Graphing Initialization, the graphing scripts read the csv files */
+        if(results.exportingCsv() && outputProfile != MINIMAL_OUTPUT){
+            cout << "Plotting R^2 Plot and Confidence Intervals!" << endl;
+            graph.graphMoments(x0.cols());
+            graph.graphConfidenceIntervals(parameters.simulateYt > 0);
+        }
 
         if(forecast(argc, argv)){
             VectorXd futureT = readCsvTimeParam(getForecastedTimes(argc, argv));
@@ -690,32 +878,11 @@ int main(int argc, char** argv){
                     observedData(t - 1, mom) = yt3Vecs[t - 1](mom - 1);
                 }
             }
-            matrixToCsv(observedData, parameters.outPath + file_without_extension + "_observed");
+            results.add("_observed", observedData);
             /* Calculate New Moments */
             cout << "--------------- Forecasted Moments in Time: ----------" << endl;
             for(int t = 0; t < futureT.size(); ++t){
-                MatrixXd XtMat = MatrixXd::Zero(x0.rows(), x0.cols());
-                for(int j = 0; j < GBVECS.cols() - 1; ++j){
-                    theta[j] = avgMu(j);
-                }
-                r.getModel()->setGlobalParameterValues(avgMu.size() - 1, 0, theta); // set new global parameter values here.
-                opt.start = futureT(0);
-                opt.duration = futureT(t);
-                for(int i = 0; i < x0.rows(); ++i){
-                    if(specifiedProteins.size() > 0){
-                        vector<double> init = r.getFloatingSpeciesInitialConcentrations();
-                        for(int p = 0; p < specifiedProteins.size(); p++){
-                            init[specifiedProteins[p]] = x0(i,p);
-                        }
-                        r.changeInitialConditions(init);
-                    }else{    
-                        r.changeInitialConditions(convertInit(x0.row(i)));
-                    }
-                    const DoubleMatrix res = *r.simulate(&opt);
-                    for(int j = 0; j < x0.cols(); ++j){
-                        XtMat(i,j) = res[res.numRows() - 1][j + 1];
-                    }
-                }
+                MatrixXd XtMat = simulator.simulate(avgMu.head(parameters.nRates), x0, futureT(0), futureT(t), gen);
                 VectorXd XtmVec = momentVector(XtMat, nMoments);
                 cout << futureT(t) <<" " << XtmVec.transpose() << endl;
                 futurecast(t,0) = futureT(t);
@@ -724,8 +891,15 @@ int main(int argc, char** argv){
                 }
             }
             cout << "------------------------------------------------------" << endl;
-            matrixToCsv(futurecast,  parameters.outPath + file_without_extension + "_forecast");
-            graph.graphForecasts(x0.cols());
+            results.add("_forecast", futurecast);
+            if(results.exportingCsv() && outputProfile != MINIMAL_OUTPUT){
+                graph.graphForecasts(x0.cols());
+            }
+        }
+        results.close();
+        /* every figure is drawn by one python process, queued after the csv exports it reads */
+        if(graph.nFigures() > 0){
+            OutputQueue::instance().submit([graph]() mutable { graph.render(); });
         }
 
     /* 
@@ -753,8 +927,10 @@ int main(int argc, char** argv){
     /* Compute 95% CI's with basic z=1.96 normal distribution assumption for now if n>1 */
     if(parameters.nRuns > 1){computeConfidenceIntervals(GBVECS, 1.96, parameters.nRates);}
 
+    OutputQueue::instance().flush(); // every file is written before the program reports and exits
     auto tB = std::chrono::high_resolution_clock::now();
     auto bDuration = std::chrono::duration_cast<std::chrono::seconds>(tB - t1).count();
+    Profiler::instance().report(std::chrono::duration<double>(tB - t1).count(), profilePath);
     cout << "CODE FINISHED RUNNING IN " << bDuration << " s TIME!" << endl;
     return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -9,6 +9,8 @@
 #include <boost/numeric/odeint.hpp>
 #include <random>
 #include <vector>
+#include <numeric>
+#include <algorithm>
 #include <Eigen/Dense>
 #include <Eigen/Core>
 #include <unsupported/Eigen/MatrixFunctions>
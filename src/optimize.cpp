@@ -0,0 +1,311 @@
+#include "optimize.hpp"
+#include <Eigen/Eigenvalues>
+
+VectorXd clampToUnitCube(const VectorXd &x){
+    return x.cwiseMax(0.0).cwiseMin(1.0);
+}
+
+/* evaluates every column of points in parallel */
+static VectorXd evaluateAll(const Objective &f, const MatrixXd &points){
+    VectorXd costs(points.cols());
+#pragma omp parallel for schedule(dynamic)
+    for(int i = 0; i < points.cols(); ++i){
+        costs(i) = f(points.col(i));
+    }
+    return costs;
+}
+
+/*
+    Summary:
+        Bounded Nelder-Mead simplex search (reflection 1, expansion 2, contraction 0.5, shrink 0.5), trial points are clamped to the
+        unit hypercube. The initial simplex and shrink steps are evaluated in parallel.
+    Input:
+        f - objective
+        start - starting position (i.e the global best of the PSO) and startCost its cost
+        budget - maximum number of cost evaluations, the start is returned unchanged if it cannot pay for the n initial vertices
+        initialStep - edge length of the initial simplex
+        tolerance - stops once the costs and vertices of the simplex are within tolerance of each other
+*/
+RefinementResult nelderMead(const Objective &f, const VectorXd &start, double startCost, long budget, double initialStep, double tolerance){
+    int n = start.size();
+    if(budget < n){ // not enough evaluations to build the initial simplex
+        RefinementResult result = {start, startCost, 0};
+        return result;
+    }
+    MatrixXd simplex(n, n + 1);
+    simplex.col(0) = start;
+    for(int i = 0; i < n; ++i){
+        VectorXd vertex = start;
+        vertex(i) += (vertex(i) + initialStep <= 1) ? initialStep : -initialStep; // step inwards at the upper bound
+        simplex.col(i + 1) = clampToUnitCube(vertex);
+    }
+    VectorXd costs(n + 1);
+    costs(0) = startCost;
+    costs.tail(n) = evaluateAll(f, simplex.rightCols(n));
+    long evaluations = n;
+
+    while(evaluations < budget){
+        /* order vertices from best to worst */
+        vector<int> order(n + 1);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](int a, int b){ return costs(a) < costs(b); });
+        MatrixXd sorted(n, n + 1);
+        VectorXd sortedCosts(n + 1);
+        for(int i = 0; i < n + 1; ++i){
+            sorted.col(i) = simplex.col(order[i]);
+            sortedCosts(i) = costs(order[i]);
+        }
+        simplex = sorted;
+        costs = sortedCosts;
+        double size = (simplex.rightCols(n).colwise() - simplex.col(0)).cwiseAbs().maxCoeff();
+        if(costs(n) - costs(0) <= tolerance * (std::abs(costs(0)) + tolerance) && size <= tolerance){
+            break;
+        }
+
+        VectorXd centroid = simplex.leftCols(n).rowwise().mean();
+        VectorXd reflected = clampToUnitCube(centroid + (centroid - simplex.col(n)));
+        double reflectedCost = f(reflected);
+        evaluations++;
+        if(reflectedCost < costs(0) && evaluations < budget){
+            VectorXd expanded = clampToUnitCube(centroid + 2 * (centroid - simplex.col(n)));
+            double expandedCost = f(expanded);
+            evaluations++;
+            if(expandedCost < reflectedCost){
+                simplex.col(n) = expanded;
+                costs(n) = expandedCost;
+            }else{
+                simplex.col(n) = reflected;
+                costs(n) = reflectedCost;
+            }
+        }else if(reflectedCost < costs(n - 1)){
+            simplex.col(n) = reflected;
+            costs(n) = reflectedCost;
+        }else if(evaluations < budget){
+            bool outside = reflectedCost < costs(n);
+            VectorXd contracted = outside ? VectorXd(centroid + 0.5 * (reflected - centroid)) : VectorXd(centroid + 0.5 * (simplex.col(n) - centroid));
+            double contractedCost = f(contracted);
+            evaluations++;
+            if(contractedCost < std::min(reflectedCost, costs(n))){
+                simplex.col(n) = contracted;
+                costs(n) = contractedCost;
+            }else{ // shrink towards the best vertex, only as many vertices as the budget has evaluations left
+                int nShrink = std::min<long>(n, budget - evaluations);
+                for(int i = 1; i < nShrink + 1; ++i){
+                    simplex.col(i) = simplex.col(0) + 0.5 * (simplex.col(i) - simplex.col(0));
+                }
+                costs.segment(1, nShrink) = evaluateAll(f, simplex.middleCols(1, nShrink));
+                evaluations += nShrink;
+            }
+        }
+    }
+    int best = 0;
+    costs.minCoeff(&best);
+    RefinementResult result = {simplex.col(best), costs(best), evaluations};
+    return result;
+}
+
+/*
+    Summary:
+        Bounded compass (pattern) search. All 2n points +-step along each axis are polled in parallel, the best improving point is taken,
+        otherwise the step is halved until it is smaller than minStep or the budget is used up.
+*/
+RefinementResult patternSearch(const Objective &f, const VectorXd &start, double startCost, long budget, double initialStep, double minStep){
+    int n = start.size();
+    VectorXd best = start;
+    double bestCost = startCost;
+    double step = initialStep;
+    long evaluations = 0;
+    while(step >= minStep && evaluations + 2 * n <= budget){
+        MatrixXd poll(n, 2 * n);
+        for(int i = 0; i < n; ++i){
+            VectorXd up = best, down = best;
+            up(i) += step;
+            down(i) -= step;
+            poll.col(2 * i) = clampToUnitCube(up);
+            poll.col(2 * i + 1) = clampToUnitCube(down);
+        }
+        VectorXd costs = evaluateAll(f, poll);
+        evaluations += 2 * n;
+        int idx = 0;
+        if(costs.minCoeff(&idx) < bestCost){
+            best = poll.col(idx);
+            bestCost = costs(idx);
+        }else{
+            step /= 2;
+        }
+    }
+    RefinementResult result = {best, bestCost, evaluations};
+    return result;
+}
+
+/* forward difference jacobian of r at x (rx = r(x)), one column per parameter computed in parallel, steps point inwards at the upper bound */
+MatrixXd finiteDifferenceJacobian(const ResidualFunction &r, const VectorXd &x, const VectorXd &rx, double step){
+    MatrixXd J(rx.size(), x.size());
+#pragma omp parallel for schedule(dynamic)
+    for(int j = 0; j < x.size(); ++j){
+        VectorXd xh = x;
+        double h = (x(j) + step <= 1) ? step : -step;
+        xh(j) += h;
+        J.col(j) = (r(xh) - rx) / h;
+    }
+    return J;
+}
+
+/*
+    Summary:
+        Levenberg-Marquardt (Gauss-Newton with adaptive damping of the diagonal) on the residuals r, iterates are clamped to the unit
+        hypercube. Every jacobian costs one evaluation per parameter, evaluated in parallel.
+    Input:
+        startCost - cost of start known to the caller, steps are only taken if they improve on it. The residuals at start are still
+                    evaluated once for the first jacobian.
+        budget - maximum number of residual evaluations
+        fdStep - finite difference step in unit hypercube coordinates
+        tolerance - stops once the relative cost decrease of an accepted step falls below tolerance
+*/
+RefinementResult levenbergMarquardt(const ResidualFunction &r, const VectorXd &start, double startCost, long budget, double fdStep, double tolerance){
+    int n = start.size();
+    VectorXd x = start;
+    double cost = startCost;
+    if(budget < n + 2){ // the residuals, a jacobian and one trial step
+        RefinementResult result = {x, cost, 0};
+        return result;
+    }
+    VectorXd rx = r(x);
+    long evaluations = 1;
+    double lambda = 1e-3;
+    while(evaluations + n + 1 <= budget){
+        MatrixXd J = finiteDifferenceJacobian(r, x, rx, fdStep);
+        evaluations += n;
+        MatrixXd JtJ = J.transpose() * J;
+        VectorXd gradient = J.transpose() * rx;
+        bool accepted = false;
+        while(!accepted && evaluations < budget && lambda < 1e10){
+            MatrixXd A = JtJ;
+            A.diagonal() += lambda * JtJ.diagonal().cwiseMax(1e-12);
+            VectorXd trial = clampToUnitCube(x - A.ldlt().solve(gradient));
+            VectorXd rTrial = r(trial);
+            evaluations++;
+            double trialCost = rTrial.squaredNorm();
+            if(trialCost < cost){
+                accepted = true;
+                double decrease = (cost - trialCost) / std::max(cost, 1e-300);
+                x = trial;
+                rx = rTrial;
+                cost = trialCost;
+                lambda = std::max(lambda / 10, 1e-12);
+                if(decrease < tolerance){
+                    RefinementResult result = {x, cost, evaluations};
+                    return result;
+                }
+            }else{
+                lambda *= 10;
+            }
+        }
+        if(!accepted){
+            break;
+        }
+    }
+    RefinementResult result = {x, cost, evaluations};
+    return result;
+}
+
+/*
+    Summary:
+        (mu/mu_w, lambda) CMA-ES with cumulative step size adaptation and rank one and rank mu covariance updates (Hansen's tutorial
+        defaults). Samples outside the unit hypercube are repaired by clamping them before they are evaluated and used in the update.
+        Every generation is evaluated in parallel.
+    Input:
+        start - initial mean (i.e the PSO seed)
+        afterGeneration - called with the population (one column per sample), the best position and cost so far, returns true to stop
+    Output:
+        best position found, its cost and the number of cost evaluations
+*/
+RefinementResult cmaes(const Objective &f, const VectorXd &start, const CMAESSettings &settings, const GenerationCallback &afterGeneration){
+    int n = start.size();
+    int lambda = settings.lambda > 0 ? settings.lambda : 4 + int(3 * std::log(n));
+    int mu = lambda / 2;
+    VectorXd w(mu);
+    for(int i = 0; i < mu; ++i){
+        w(i) = std::log(mu + 0.5) - std::log(i + 1.0);
+    }
+    w /= w.sum();
+    double mueff = 1.0 / w.squaredNorm();
+    double cc = (4 + mueff / n) / (n + 4 + 2 * mueff / n);
+    double cs = (mueff + 2) / (n + mueff + 5);
+    double c1 = 2 / ((n + 1.3) * (n + 1.3) + mueff);
+    double cmu = std::min(1 - c1, 2 * (mueff - 2 + 1 / mueff) / ((n + 2) * (n + 2) + mueff));
+    double damps = 1 + 2 * std::max(0.0, std::sqrt((mueff - 1) / (n + 1)) - 1) + cs;
+    double chiN = std::sqrt(double(n)) * (1 - 1.0 / (4 * n) + 1.0 / (21.0 * n * n));
+
+    mt19937 gen(settings.seed);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    VectorXd mean = clampToUnitCube(start);
+    double sigma = settings.sigma;
+    MatrixXd C = MatrixXd::Identity(n, n);
+    VectorXd pc = VectorXd::Zero(n), ps = VectorXd::Zero(n);
+    VectorXd best = mean;
+    double bestCost = std::numeric_limits<double>::infinity();
+    long evaluations = 0;
+
+    for(int g = 0; g < settings.maxGenerations; ++g){
+        Eigen::SelfAdjointEigenSolver<MatrixXd> eig(C);
+        MatrixXd B = eig.eigenvectors();
+        VectorXd D = eig.eigenvalues().cwiseMax(1e-20).cwiseSqrt();
+        MatrixXd population(n, lambda);
+        for(int k = 0; k < lambda; ++k){
+            VectorXd z(n);
+            for(int i = 0; i < n; ++i){
+                z(i) = normal(gen);
+            }
+            population.col(k) = clampToUnitCube(mean + sigma * (B * D.asDiagonal() * z));
+        }
+        VectorXd costs = evaluateAll(f, population);
+        evaluations += lambda;
+
+        vector<int> order(lambda);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](int a, int b){ return costs(a) < costs(b); });
+        if(costs(order[0]) < bestCost){
+            bestCost = costs(order[0]);
+            best = population.col(order[0]);
+        }
+
+        VectorXd oldMean = mean;
+        mean = VectorXd::Zero(n);
+        for(int i = 0; i < mu; ++i){
+            mean += w(i) * population.col(order[i]);
+        }
+        VectorXd yw = (mean - oldMean) / sigma;
+        MatrixXd invSqrtC = B * D.cwiseInverse().asDiagonal() * B.transpose();
+        ps = (1 - cs) * ps + std::sqrt(cs * (2 - cs) * mueff) * invSqrtC * yw;
+        bool hsig = ps.norm() / std::sqrt(1 - std::pow(1 - cs, 2.0 * (g + 1))) / chiN < 1.4 + 2.0 / (n + 1);
+        pc = (1 - cc) * pc + (hsig ? std::sqrt(cc * (2 - cc) * mueff) : 0.0) * yw;
+        MatrixXd rankMu = MatrixXd::Zero(n, n);
+        for(int i = 0; i < mu; ++i){
+            VectorXd y = (population.col(order[i]) - oldMean) / sigma;
+            rankMu += w(i) * y * y.transpose();
+        }
+        C = (1 - c1 - cmu) * C + c1 * (pc * pc.transpose() + (hsig ? 0.0 : cc * (2 - cc)) * C) + cmu * rankMu;
+        C = 0.5 * (C + C.transpose()); // keep symmetric against round off
+        sigma *= std::exp((cs / damps) * (ps.norm() / chiN - 1));
+
+        if(afterGeneration(population, best, bestCost)){
+            break;
+        }
+    }
+    RefinementResult result = {best, bestCost, evaluations};
+    return result;
+}
+
+/* runs the refinement method selected in the configuration file */
+RefinementResult refine(int method, const Objective &f, const ResidualFunction &r, const VectorXd &start, double startCost, long budget){
+    if(method == LEVENBERG_MARQUARDT){
+        return levenbergMarquardt(r, start, startCost, budget);
+    }else if(method == NELDER_MEAD){
+        return nelderMead(f, start, startCost, budget);
+    }else if(method == PATTERN_SEARCH){
+        return patternSearch(f, start, startCost, budget);
+    }
+    RefinementResult result = {start, startCost, 0};
+    return result;
+}
@@ -0,0 +1,43 @@
+#ifndef _OPTIMIZE_HPP_
+#define _OPTIMIZE_HPP_
+/*
+Author: John Wu
+Summary: Local refinement of an estimate found by the PSO and the CMA-ES alternative to the PSO. All methods work on positions in the unit
+hypercube (the same coordinates as the PSO before scaling by the hypercube dimension), keep points inside its bounds and stop after a fixed
+budget of cost evaluations.
+ */
+#include "main.hpp"
+#include <functional>
+
+/* cost of a position in the unit hypercube, evaluated from several threads at once */
+typedef std::function<double(const VectorXd &)> Objective;
+/* residual vector whose squared norm is the cost, used by the least squares methods */
+typedef std::function<VectorXd(const VectorXd &)> ResidualFunction;
+
+enum RefinementMethod { NO_REFINEMENT, NELDER_MEAD, PATTERN_SEARCH, LEVENBERG_MARQUARDT };
+
+struct RefinementResult {
+    VectorXd position;
+    double cost;
+    long evaluations;
+};
+
+VectorXd clampToUnitCube(const VectorXd &x);
+RefinementResult nelderMead(const Objective &f, const VectorXd &start, double startCost, long budget, double initialStep = 0.1, double tolerance = 1e-8);
+RefinementResult patternSearch(const Objective &f, const VectorXd &start, double startCost, long budget, double initialStep = 0.1, double minStep = 1e-6);
+MatrixXd finiteDifferenceJacobian(const ResidualFunction &r, const VectorXd &x, const VectorXd &rx, double step);
+RefinementResult levenbergMarquardt(const ResidualFunction &r, const VectorXd &start, double startCost, long budget, double fdStep = 1e-4, double tolerance = 1e-10);
+/* Called after every CMA-ES generation with its (repaired) population and the best cost so far, returns true to stop */
+typedef std::function<bool(const MatrixXd &, const VectorXd &, double)> GenerationCallback;
+
+struct CMAESSettings {
+    int lambda; // population size, <= 0 for the default 4 + 3 ln(n)
+    int maxGenerations;
+    double sigma; // initial step size in unit hypercube coordinates
+    unsigned int seed;
+};
+
+RefinementResult cmaes(const Objective &f, const VectorXd &start, const CMAESSettings &settings, const GenerationCallback &afterGeneration);
+RefinementResult refine(int method, const Objective &f, const ResidualFunction &r, const VectorXd &start, double startCost, long budget);
+
+#endif
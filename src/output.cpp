@@ -0,0 +1,72 @@
+#include "output.hpp"
+#include "profiler.hpp"
+
+OutputQueue& OutputQueue::instance(){
+    static OutputQueue queue;
+    return queue;
+}
+
+OutputQueue::~OutputQueue(){
+    flush();
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    if(worker.joinable()){
+        worker.join();
+    }
+}
+
+void OutputQueue::setAsynchronous(bool enabled){
+    flush();
+    std::lock_guard<std::mutex> guard(lock);
+    asynchronous = enabled;
+}
+
+/* Copies of the data to write must be captured by value, the caller may change or free its own right after submitting */
+void OutputQueue::submit(std::function<void()> job){
+    std::unique_lock<std::mutex> guard(lock);
+    if(!asynchronous){
+        guard.unlock();
+        job();
+        return;
+    }
+    if(!worker.joinable()){
+        worker = std::thread(&OutputQueue::work, this);
+    }
+    jobs.push_back(std::move(job));
+    guard.unlock();
+    wake.notify_one();
+}
+
+/* Blocks until every job submitted so far has finished */
+void OutputQueue::flush(){
+    std::unique_lock<std::mutex> guard(lock);
+    idle.wait(guard, [this](){ return jobs.empty() && !busy; });
+}
+
+void OutputQueue::work(){
+    Profiler::instance().setThreadId(-1);
+    std::unique_lock<std::mutex> guard(lock);
+    while(true){
+        wake.wait(guard, [this](){ return stopping || !jobs.empty(); });
+        if(jobs.empty()){
+            return; // stopping
+        }
+        std::function<void()> job = std::move(jobs.front());
+        jobs.pop_front();
+        busy = true;
+        guard.unlock();
+        try{
+            job();
+        }catch(const std::exception &e){
+            cout << "Error writing output: " << e.what() << endl;
+        }
+        guard.lock();
+        busy = false;
+        if(jobs.empty()){
+            idle.notify_all();
+        }
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef _OUTPUT_HPP_
+#define _OUTPUT_HPP_
+/*
+Author: John Wu
+Summary: Background output queue. Writing files (surrogate data, results, csv exports) and graphing are submitted as jobs that a single
+worker thread runs in submission order while the PSO keeps computing. flush() is the barrier used before anything reads the written files
+and before the program exits.
+ */
+#include "main.hpp"
+#include <functional>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+class OutputQueue{
+    public:
+        static OutputQueue& instance();
+        void submit(std::function<void()> job);
+        void flush();
+        void setAsynchronous(bool enabled);
+        ~OutputQueue();
+    private:
+        OutputQueue() : busy(false), stopping(false), asynchronous(true) {}
+        void work();
+        std::mutex lock;
+        std::condition_variable wake; // a job was submitted or the queue is stopping
+        std::condition_variable idle; // the last job finished
+        std::deque<std::function<void()>> jobs;
+        bool busy;
+        bool stopping;
+        bool asynchronous; // when off, jobs run on the submitting thread
+        std::thread worker; // started with the first asynchronous job
+};
+
+#endif
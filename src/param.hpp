@@ -2,6 +2,48 @@
 #define _PARAM_HPP_
 #include "main.hpp"
 #include "fileIO.hpp"
+#include <map>
+#include <algorithm>
+/* Optional configuration entries, matched by their label so they can be placed on any line of the configuration file */
+static const vector<string> optionalParameterLabels = {
+    "Use Tau Leaping?",
+    "Tau Leap Epsilon",
+    "Tau Leap Critical Count",
+    "Tau Leap SSA Threshold",
+    "Common Random Numbers?",
+    "Auto Select Integrator?",
+    "Stiffness Threshold",
+    "PSO Relative Tolerance",
+    "PSO Absolute Tolerance",
+    "Final Relative Tolerance",
+    "Final Absolute Tolerance",
+    "Max Integrator Steps",
+    "Multi Fidelity?",
+    "Initial Cell Fraction",
+    "Full Fidelity At",
+    "Early Termination?",
+    "Stop Window",
+    "Stop Relative Improvement",
+    "Stop Swarm Diameter",
+    "Max Run Seconds",
+    "Max Run Evaluations",
+    "Refinement Method",
+    "Refinement Evaluations",
+    "Optimizer",
+    "CMA-ES Population",
+    "CMA-ES Sigma",
+    "Surrogate Screening?",
+    "Surrogate Confidence",
+    "Surrogate Points",
+    "Contour Resolution",
+    "Contour Refinements",
+    "Profile Likelihood?",
+    "Profile Points",
+    "Profile Width",
+    "Profile Evaluations",
+    "Export CSV?",
+    "Asynchronous Output?"
+};
 //
 class Parameters{
     public:
@@ -30,6 +72,40 @@ class Parameters{
         double pBestWeight;
         double globalBestWeight;
         double pInertia;
+        int useTauLeap; // tau leaping instead of exact SSA when simulating stochastically
+        double tauEpsilon; // allowed relative change of propensities in a leap
+        int tauCriticalCount; // reactions this close to exhausting a reactant are fired exactly
+        double tauSSAThreshold; // leaps shorter than tauSSAThreshold / a0 are replaced by exact SSA steps
+        int useCRN; // same per cell random streams for every particle when simulating stochastically
+        int autoIntegrator; // choose between rk45 and cvode from a stiffness probe
+        double stiffnessThreshold; // stiffness ratio above which cvode is used
+        double psoRelTol; // integrator tolerances during the PSO, <= 0 keeps roadrunner's defaults
+        double psoAbsTol;
+        double finalRelTol; // integrator tolerances for Yt and the final re-evaluation of the estimates
+        double finalAbsTol;
+        int maxIntegratorSteps;
+        int multiFidelity; // simulate a growing subsample of the cells in early PSO steps
+        double initialCellFraction; // fraction of cells simulated in the first step
+        double fullFidelityAt; // fraction of the PSO steps after which all cells are simulated
+        int earlyTermination; // stop simulating a particle once its partial cost exceeds its personal best
+        StoppingRules stopping; // convergence based early stopping of a PSO run
+        int refinement; // local refinement after the PSO, 0 none, 1 Nelder-Mead, 2 pattern search, 3 Levenberg-Marquardt
+        long refinementBudget; // cost evaluations of the local refinement
+        int optimizer; // 0 PSO, 1 CMA-ES
+        int cmaPopulation; // samples per CMA-ES generation, <= 0 for the default 4 + 3 ln(n)
+        double cmaSigma; // initial CMA-ES step size in unit hypercube coordinates
+        int surrogateScreening; // skip particles a gaussian process surrogate predicts will not improve
+        double surrogateConfidence; // largest relative posterior variance at which the surrogate's prediction is trusted
+        int surrogatePoints; // most recent evaluations the surrogate is trained on
+        int contourResolution; // grid points along each axis of a contour
+        int contourRefinements; // number of zoomed grids evaluated around the minimum of the previous grid
+        int profileLikelihood; // profile likelihood confidence intervals of the least cost estimate
+        int profilePoints; // grid points of every profile
+        double profileWidth; // half width of every profile in unit hypercube coordinates
+        long profileBudget; // cost evaluations of the re-optimization at every profile point
+        int exportCsv; // write every result array as csv next to the binary results container
+        int asyncOutput; // write files and graphs on a background thread
+        std::map<string, double> options; // optional labeled entries
         Parameters(const string &path){
             cout << "Reading in Parameters from Configuration File!" << endl;
             std::ifstream input(path);
@@ -42,6 +118,15 @@ class Parameters{
             while(std::getline(input, line)){
                 std::stringstream ss(line); // make a string stream from the line such that you can isolate each word even further.
                 string col;
+                string label = line.substr(0, line.find(','));
+                if(std::find(optionalParameterLabels.begin(), optionalParameterLabels.end(), label) != optionalParameterLabels.end() && label.size() < line.size()){
+                    string value = line.substr(label.size() + 1);
+                    value.erase(std::remove_if(value.begin(), value.end(), ::isspace), value.end());
+                    if(isNumber(value) || isDouble(value)){
+                        options[label] = std::stod(value);
+                    }
+                    continue;
+                }
                 while(std::getline(ss, col, ',')){
                     if(isNumber(col) || isDouble(col)){ // only add into parameter vector if actually an int.
                         params.push_back(std::stod(col)); 
@@ -66,11 +151,56 @@ class Parameters{
             pBestWeight = params.at(15);
             globalBestWeight = params.at(16);
             pInertia = params.at(17);
+            useTauLeap = option("Use Tau Leaping?", 0);
+            tauEpsilon = option("Tau Leap Epsilon", 0.03);
+            tauCriticalCount = option("Tau Leap Critical Count", 10);
+            tauSSAThreshold = option("Tau Leap SSA Threshold", 10);
+            useCRN = option("Common Random Numbers?", 0);
+            autoIntegrator = option("Auto Select Integrator?", 0);
+            stiffnessThreshold = option("Stiffness Threshold", 1000);
+            psoRelTol = option("PSO Relative Tolerance", -1);
+            psoAbsTol = option("PSO Absolute Tolerance", -1);
+            finalRelTol = option("Final Relative Tolerance", -1);
+            finalAbsTol = option("Final Absolute Tolerance", -1);
+            maxIntegratorSteps = option("Max Integrator Steps", -1);
+            multiFidelity = option("Multi Fidelity?", 0);
+            initialCellFraction = option("Initial Cell Fraction", 0.1);
+            fullFidelityAt = option("Full Fidelity At", 0.5);
+            earlyTermination = option("Early Termination?", 0);
+            stopping.window = option("Stop Window", 0);
+            stopping.relativeImprovement = option("Stop Relative Improvement", 1e-4);
+            stopping.swarmDiameter = option("Stop Swarm Diameter", -1);
+            stopping.maxSeconds = option("Max Run Seconds", -1);
+            stopping.maxEvaluations = option("Max Run Evaluations", -1);
+            refinement = option("Refinement Method", 0);
+            refinementBudget = option("Refinement Evaluations", 200);
+            optimizer = option("Optimizer", 0);
+            cmaPopulation = option("CMA-ES Population", -1);
+            cmaSigma = option("CMA-ES Sigma", 0.3);
+            surrogateScreening = option("Surrogate Screening?", 0);
+            surrogateConfidence = option("Surrogate Confidence", 0.1);
+            surrogatePoints = option("Surrogate Points", 400);
+            contourResolution = option("Contour Resolution", 25);
+            contourRefinements = option("Contour Refinements", 0);
+            profileLikelihood = option("Profile Likelihood?", 0);
+            profilePoints = option("Profile Points", 11);
+            profileWidth = option("Profile Width", 0.2);
+            profileBudget = option("Profile Evaluations", 100);
+            exportCsv = option("Export CSV?", 1);
+            asyncOutput = option("Asynchronous Output?", 1);
             
             useSBML = 0;
             outPath = "";
             input.close();
         }
+        /* value of an optional labeled entry, defaultValue if it is not in the configuration file */
+        double option(const string &label, double defaultValue) const{
+            auto it = options.find(label);
+            if(it == options.end()){
+                return defaultValue;
+            }
+            return it->second;
+        }
         void printParameters(int nMoments, const VectorXd& times){
             cout << "---------------------  Parameters  --------------------" << endl;
             if(useLinear){
@@ -88,16 +218,60 @@ class Parameters{
             // }
             cout << "Hyper Cube Width:" << hyperCubeScale << endl;
             cout << "Using Times:" << times.transpose() << endl;
-            cout << "Blind PSO --> nParts:" << nParts << " Nsteps:" << nSteps << endl;
+            if(optimizer == 1){
+                cout << "CMA-ES --> population:" << cmaPopulation << " generations:" << nSteps << " sigma:" << cmaSigma << endl;
+            }else{
+                cout << "Blind PSO --> nParts:" << nParts << " Nsteps:" << nSteps << endl;
+            }
             // cout << "Targeted PSO --> nParts:" <<  nParts2 << " Nsteps:" << nSteps2 << endl;
             cout << "Number of Rates:" << nRates << endl;
+            if(multiFidelity > 0){
+                cout << "Multi Fidelity PSO --> initial cell fraction:" << initialCellFraction << " full fidelity after:" << fullFidelityAt * nSteps << " steps" << endl;
+            }
+            if(earlyTermination > 0){
+                cout << "Terminating Particle Evaluations Early Once They Exceed Their Personal Best!" << endl;
+            }
+            if(stopping.window > 0){
+                cout << "Stopping Runs Once The Cost Improves By Less Than " << stopping.relativeImprovement << " Over " << stopping.window << " Steps" << endl;
+            }
+            if(stopping.swarmDiameter > 0){
+                cout << "Stopping Runs Once The Swarm Diameter Is Below " << stopping.swarmDiameter << endl;
+            }
+            if(stopping.maxSeconds > 0 || stopping.maxEvaluations > 0){
+                cout << "Run Limits --> seconds:" << stopping.maxSeconds << " evaluations:" << stopping.maxEvaluations << endl;
+            }
+            if(refinement == 1){
+                cout << "Refining PSO Estimates With Nelder-Mead, Budget:" << refinementBudget << " Evaluations" << endl;
+            }else if(refinement == 2){
+                cout << "Refining PSO Estimates With Pattern Search, Budget:" << refinementBudget << " Evaluations" << endl;
+            }else if(refinement == 3){
+                cout << "Refining PSO Estimates With Levenberg-Marquardt, Budget:" << refinementBudget << " Evaluations" << endl;
+                if(useSBML && useDet <= 0){
+                    cout << "Note: Levenberg-Marquardt's finite difference jacobians need smooth costs, use deterministic simulation or common random numbers!" << endl;
+                }
+            }
+            if(surrogateScreening > 0){
+                cout << "Screening Particles With A Surrogate Trained On The Last " << surrogatePoints << " Evaluations, Confidence:" << surrogateConfidence << endl;
+            }
+            if(profileLikelihood > 0){
+                cout << "Profile Likelihood Intervals --> points:" << profilePoints << " width:" << profileWidth << " evaluations per point:" << profileBudget << endl;
+            }
             cout << "Particle Best Weight:" << pBestWeight << " Global Best Weight:"<< globalBestWeight << " Particle Inertia:" << pInertia << endl;
             if(useSBML){
                 cout << "Redirecting Model to SBML/BNGL" << endl;
                 if(useDet > 0){
                     cout << "Modeling With Deterministic ODEs" << endl;
+                    if(autoIntegrator > 0){
+                        cout << "Choosing Integrator From Stiffness Probe With Threshold:" << stiffnessThreshold << endl;
+                    }
                 }else{
                     cout << "Modeling with Gillespie" << endl;
+                    if(useTauLeap > 0){
+                        cout << "Using Tau Leaping --> epsilon:" << tauEpsilon << " critical count:" << tauCriticalCount << " SSA threshold:" << tauSSAThreshold << endl;
+                    }
+                    if(useCRN > 0){
+                        cout << "Using Common Random Numbers Across Particles!" << endl;
+                    }
                 }
                 cout << "Number of Steps of Integration Determined:" << odeSteps << endl;
             }
@@ -0,0 +1,76 @@
+#include "profile.hpp"
+
+/*
+    Summary:
+        Computes the profile of every coordinate of best. Grid points that fall outside the hypercube are clamped to its boundary.
+    Input:
+        f, r - cost and residuals of free positions in the unit hypercube, r is only used by Levenberg-Marquardt
+        best - best estimate of the free positions, every re-optimization starts from it
+        settings - grid and re-optimization settings
+    Output:
+        one profile per coordinate of best
+*/
+vector<Profile> profileLikelihood(const Objective &f, const ResidualFunction &r, const VectorXd &best, const ProfileSettings &settings){
+    int n = best.size();
+    int points = std::max(settings.points, 2);
+    vector<Profile> profiles(n);
+    for(int k = 0; k < n; ++k){
+        profiles[k].positions = VectorXd::LinSpaced(points, best(k) - settings.width, best(k) + settings.width).cwiseMax(0.0).cwiseMin(1.0);
+        profiles[k].costs = VectorXd::Zero(points);
+        profiles[k].optima = MatrixXd::Zero(points, n);
+    }
+
+    /* evaluations inside a task run on the thread of the task, refinements only parallelize when called outside of a parallel region */
+#pragma omp parallel for schedule(dynamic)
+    for(int task = 0; task < n * points; ++task){
+        int k = task / points;
+        int p = task % points;
+        double fixed = profiles[k].positions(p);
+        auto full = [&](const VectorXd &others){
+            VectorXd x(n);
+            x.head(k) = others.head(k);
+            x(k) = fixed;
+            x.tail(n - k - 1) = others.tail(n - k - 1);
+            return x;
+        };
+        VectorXd start(n - 1);
+        start.head(k) = best.head(k);
+        start.tail(n - k - 1) = best.tail(n - k - 1);
+        VectorXd x = full(start);
+        double cost = f(x);
+        if(n > 1){
+            Objective reduced = [&](const VectorXd &others){ return f(full(others)); };
+            ResidualFunction reducedResiduals = [&](const VectorXd &others){ return r(full(others)); };
+            RefinementResult result = refine(settings.method, reduced, reducedResiduals, start, cost, settings.budget);
+            if(result.cost < cost){
+                x = full(result.position);
+                cost = result.cost;
+            }
+        }
+        profiles[k].costs(p) = cost;
+        profiles[k].optima.row(p) = x;
+    }
+    return profiles;
+}
+
+/*
+    Summary:
+        Walks outward from the lowest point of a profile while the cost stays within threshold of bestCost.
+    Output:
+        lower and upper positions of the interval, returns false if the profile never crosses the threshold on at least one side, i.e
+        the rate is not identifiable within the profiled range
+*/
+bool profileInterval(const Profile &profile, double bestCost, double threshold, double &lower, double &upper){
+    int center = 0;
+    profile.costs.minCoeff(&center);
+    int low = center, high = center;
+    while(low > 0 && profile.costs(low - 1) - bestCost <= threshold){
+        low--;
+    }
+    while(high < profile.costs.size() - 1 && profile.costs(high + 1) - bestCost <= threshold){
+        high++;
+    }
+    lower = profile.positions(low);
+    upper = profile.positions(high);
+    return low > 0 && high < profile.costs.size() - 1;
+}
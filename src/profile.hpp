@@ -0,0 +1,29 @@
+#ifndef _PROFILE_HPP_
+#define _PROFILE_HPP_
+/*
+Author: John Wu
+Summary: Profile likelihood confidence intervals. Each free rate is fixed on a grid around the best estimate and the remaining free rates are
+re-optimized from the best estimate with one of the local refinement methods. Every (rate, grid point) pair is an independent task, so all
+profiles run concurrently.
+ */
+#include "main.hpp"
+#include "optimize.hpp"
+
+struct ProfileSettings {
+    int points; // grid points of every profile, centered on the best estimate
+    double width; // half width of the grid in unit hypercube coordinates
+    long budget; // cost evaluations of the re-optimization at every grid point
+    int method; // RefinementMethod used to re-optimize the other rates
+};
+
+/* Profile of a single rate, positions are in unit hypercube coordinates and sorted */
+struct Profile {
+    VectorXd positions;
+    VectorXd costs;
+    MatrixXd optima; // re-optimized free positions at every grid point, one row per point
+};
+
+vector<Profile> profileLikelihood(const Objective &f, const ResidualFunction &r, const VectorXd &best, const ProfileSettings &settings);
+bool profileInterval(const Profile &profile, double bestCost, double threshold, double &lower, double &upper);
+
+#endif
@@ -0,0 +1,132 @@
+#include "profiler.hpp"
+
+static thread_local ThreadTimes* threadTimes = nullptr;
+
+Profiler& Profiler::instance(){
+    static Profiler profiler;
+    return profiler;
+}
+
+const char* Profiler::phaseName(Phase phase){
+    switch(phase){
+        case SIMULATION: return "simulation";
+        case MOMENTS: return "moments";
+        case COST: return "cost";
+        case WEIGHTS: return "weights";
+        case IO: return "io";
+        case GRAPHING: return "graphing";
+        default: return "unknown";
+    }
+}
+
+/* Registers the calling thread on its first timing, after that there is no locking */
+ThreadTimes& Profiler::local(){
+    if(threadTimes == nullptr){
+        std::unique_ptr<ThreadTimes> times(new ThreadTimes());
+        times->thread = omp_get_thread_num();
+        for(int p = 0; p < N_PHASES; ++p){
+            times->seconds[p] = 0;
+            times->calls[p] = 0;
+        }
+        threadTimes = times.get();
+        std::lock_guard<std::mutex> guard(lock);
+        threads.push_back(std::move(times));
+    }
+    return *threadTimes;
+}
+
+void Profiler::add(Phase phase, double seconds){
+    ThreadTimes& times = local();
+    times.seconds[phase] += seconds;
+    times.calls[phase]++;
+}
+
+void Profiler::setThreadId(int id){
+    local().thread = id;
+}
+
+void Profiler::recordStep(int run, int step, long evaluations, double seconds){
+    std::lock_guard<std::mutex> guard(lock);
+    StepTimes s = {run, step, evaluations, seconds};
+    steps.push_back(s);
+}
+
+/*
+    Summary:
+        Prints a table of accumulated wall time per thread and per phase and writes the same information (plus the per step throughput) to jsonPath.
+    Input:
+        totalSeconds - total run time of the program
+        jsonPath - file to write the json report to
+ */
+void Profiler::report(double totalSeconds, const string &jsonPath){
+    std::lock_guard<std::mutex> guard(lock);
+    std::sort(threads.begin(), threads.end(), [](const std::unique_ptr<ThreadTimes> &a, const std::unique_ptr<ThreadTimes> &b){ return a->thread < b->thread; });
+    double totals[N_PHASES] = {0};
+    long calls[N_PHASES] = {0};
+    for(const auto &t : threads){
+        for(int p = 0; p < N_PHASES; ++p){
+            totals[p] += t->seconds[p];
+            calls[p] += t->calls[p];
+        }
+    }
+    cout << "------------------- Profile (wall seconds) -------------------" << endl;
+    cout << std::left << std::setw(10) << "thread";
+    for(int p = 0; p < N_PHASES; ++p){
+        cout << std::setw(12) << phaseName(Phase(p));
+    }
+    cout << endl << std::fixed << std::setprecision(3);
+    for(const auto &t : threads){
+        cout << std::setw(10) << t->thread;
+        for(int p = 0; p < N_PHASES; ++p){
+            cout << std::setw(12) << t->seconds[p];
+        }
+        cout << endl;
+    }
+    cout << std::setw(10) << "total";
+    for(int p = 0; p < N_PHASES; ++p){
+        cout << std::setw(12) << totals[p];
+    }
+    cout << endl << std::setw(10) << "calls";
+    for(int p = 0; p < N_PHASES; ++p){
+        cout << std::setw(12) << calls[p];
+    }
+    cout << endl << "Note: per phase totals are summed across threads and can exceed the wall time of " << totalSeconds << " s." << endl;
+    if(steps.size() > 0){ // per step throughput is only written to the json, the console gets the average
+        long stepEvaluations = 0;
+        double stepSeconds = 0;
+        for(const StepTimes &s : steps){
+            stepEvaluations += s.evaluations;
+            stepSeconds += s.seconds;
+        }
+        cout << steps.size() << " PSO steps: " << stepEvaluations << " evaluations in " << stepSeconds << " s (" << stepEvaluations / std::max(stepSeconds, 1e-12) << " evals/s)" << endl;
+    }
+    cout << std::defaultfloat << std::right;
+    cout << "--------------------------------------------------------------" << endl;
+
+    std::ofstream json(jsonPath);
+    if(!json.is_open()){
+        cout << "Unable to write profile to " << jsonPath << endl;
+        return;
+    }
+    json.precision(9);
+    json << "{" << endl << "  \"totalSeconds\": " << totalSeconds << "," << endl;
+    json << "  \"phases\": {";
+    for(int p = 0; p < N_PHASES; ++p){
+        json << (p == 0 ? "" : ",") << endl << "    \"" << phaseName(Phase(p)) << "\": {\"seconds\": " << totals[p] << ", \"calls\": " << calls[p] << "}";
+    }
+    json << endl << "  }," << endl << "  \"threads\": [";
+    for(int t = 0; t < threads.size(); ++t){
+        json << (t == 0 ? "" : ",") << endl << "    {\"thread\": " << threads[t]->thread;
+        for(int p = 0; p < N_PHASES; ++p){
+            json << ", \"" << phaseName(Phase(p)) << "\": " << threads[t]->seconds[p];
+        }
+        json << "}";
+    }
+    json << endl << "  ]," << endl << "  \"steps\": [";
+    for(int s = 0; s < steps.size(); ++s){
+        json << (s == 0 ? "" : ",") << endl << "    {\"run\": " << steps[s].run << ", \"step\": " << steps[s].step << ", \"evaluations\": " << steps[s].evaluations
+            << ", \"seconds\": " << steps[s].seconds << ", \"evalsPerSecond\": " << steps[s].evaluations / std::max(steps[s].seconds, 1e-12) << "}";
+    }
+    json << endl << "  ]" << endl << "}" << endl;
+    json.close();
+}
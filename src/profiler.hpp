@@ -0,0 +1,60 @@
+#ifndef _PROFILER_HPP_
+#define _PROFILER_HPP_
+/*
+Author: John Wu
+Summary: Scoped wall clock timers for the hot paths of the program (simulation, moments, costs, weights, file io and graphing).
+Timings are accumulated per OpenMP thread and reported as a table and a json file once the program finishes.
+ */
+#include "main.hpp"
+#include <mutex>
+#include <memory>
+#include <iomanip>
+#include <algorithm>
+
+enum Phase { SIMULATION, MOMENTS, COST, WEIGHTS, IO, GRAPHING, N_PHASES };
+
+/* Accumulated seconds and call counts of a single thread */
+struct ThreadTimes {
+    int thread;
+    double seconds[N_PHASES];
+    long calls[N_PHASES];
+};
+
+/* Evaluation throughput of a single PSO step */
+struct StepTimes {
+    int run;
+    int step;
+    long evaluations;
+    double seconds;
+};
+
+class Profiler{
+    public:
+        static Profiler& instance();
+        void add(Phase phase, double seconds);
+        void recordStep(int run, int step, long evaluations, double seconds);
+        void setThreadId(int id); // threads outside of OpenMP, i.e the output queue (-1), would otherwise all report as thread 0
+        void report(double totalSeconds, const string &jsonPath);
+        static const char* phaseName(Phase phase);
+    private:
+        Profiler(){}
+        ThreadTimes& local();
+        std::mutex lock;
+        vector<std::unique_ptr<ThreadTimes>> threads;
+        vector<StepTimes> steps;
+};
+
+/* Adds the lifetime of the timer to the given phase of the calling thread */
+class ScopedTimer{
+    public:
+        ScopedTimer(Phase p) : phase(p), start(std::chrono::steady_clock::now()) {}
+        ~ScopedTimer(){
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            Profiler::instance().add(phase, elapsed.count());
+        }
+    private:
+        Phase phase;
+        std::chrono::steady_clock::time_point start;
+};
+
+#endif
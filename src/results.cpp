@@ -0,0 +1,95 @@
+#include "results.hpp"
+#include "fileIO.hpp"
+#include "output.hpp"
+
+static const char MAGIC[8] = {'B', 'N', 'G', 'M', 'M', 'R', '0', '1'};
+
+/* Escapes quotes and backslashes of strings written to the manifest */
+static string jsonString(const string &s){
+    string escaped = "\"";
+    for(char c : s){
+        if(c == '"' || c == '\\'){
+            escaped.push_back('\\');
+        }
+        escaped.push_back(c);
+    }
+    return escaped + "\"";
+}
+
+/*
+    Summary:
+        Opens <prefix>_results.bngmm for writing.
+    Input:
+        prefix - output directory and model name, i.e <output dir>/<model>
+        exportCsv - also write every array to <prefix><name>.csv, the files BNGMM has always written (i.e <output dir>/<model>Xt2.00.csv)
+*/
+ResultStore::ResultStore(const string &prefix, bool exportCsv) : basePath(prefix), csv(exportCsv), offset(0), closed(false){
+    data = std::make_shared<std::ofstream>(basePath + "_results.bngmm", std::ios::binary | std::ios::trunc);
+    if(!data->is_open()){
+        throw std::runtime_error("Could not open results file " + basePath + "_results.bngmm");
+    }
+    data->write(MAGIC, sizeof(MAGIC));
+    offset = sizeof(MAGIC);
+}
+
+/* The array is copied and written by the output queue, offsets are assigned right away so the manifest does not depend on it */
+void ResultStore::add(const string &name, const MatrixXd &mat, const vector<string> &labels){
+    StoredArray array = {name, mat.rows(), mat.cols(), offset, labels};
+    offset += sizeof(double) * mat.size();
+    arrays.push_back(array);
+    std::shared_ptr<std::ofstream> file = data;
+    string csvFile = csv ? basePath + name : "";
+    OutputQueue::instance().submit([file, mat, csvLabels = labels, csvFile]() mutable {
+        ScopedTimer timer(IO);
+        file->write(reinterpret_cast<const char*>(mat.data()), sizeof(double) * mat.size());
+        if(csvFile == ""){
+            return;
+        }
+        if(csvLabels.size() == mat.cols()){
+            matrixToCsvWithLabels(mat, csvLabels, csvFile);
+        }else{
+            matrixToCsv(mat, csvFile);
+        }
+    });
+}
+
+void ResultStore::setMetadata(const string &key, const string &value){
+    metadata[key] = value;
+}
+
+/* Queues the manifest after every array, flush the output queue before reading the container */
+void ResultStore::close(){
+    if(closed){
+        return;
+    }
+    closed = true;
+    std::ostringstream manifest;
+    string dataFile = basePath.substr(basePath.find_last_of("/\\") + 1) + "_results.bngmm";
+    manifest << "{" << endl;
+    manifest << "  \"format\": \"bngmm-results\", \"version\": 1, \"file\": " << jsonString(dataFile) << "," << endl;
+    manifest << "  \"layout\": \"float64 in native byte order (little endian on x86 and ARM), column major, offsets in bytes\"," << endl;
+    manifest << "  \"metadata\": {";
+    int m = 0;
+    for(const auto &entry : metadata){
+        manifest << (m++ == 0 ? "" : ", ") << jsonString(entry.first) << ": " << jsonString(entry.second);
+    }
+    manifest << "}," << endl << "  \"arrays\": [";
+    for(int i = 0; i < arrays.size(); ++i){
+        manifest << (i == 0 ? "" : ",") << endl << "    {\"name\": " << jsonString(arrays[i].name) << ", \"rows\": " << arrays[i].rows << ", \"cols\": " << arrays[i].cols
+            << ", \"offset\": " << arrays[i].offset << ", \"labels\": [";
+        for(int j = 0; j < arrays[i].labels.size(); ++j){
+            manifest << (j == 0 ? "" : ", ") << jsonString(arrays[i].labels[j]);
+        }
+        manifest << "]}";
+    }
+    manifest << endl << "  ]" << endl << "}" << endl;
+    std::shared_ptr<std::ofstream> file = data;
+    string manifestFile = basePath + "_results.json";
+    string contents = manifest.str();
+    OutputQueue::instance().submit([file, manifestFile, contents](){
+        file->close();
+        std::ofstream out(manifestFile);
+        out << contents;
+        out.close();
+    });
+}
@@ -0,0 +1,39 @@
+#ifndef _RESULTS_HPP_
+#define _RESULTS_HPP_
+/*
+Author: John Wu
+Summary: Single binary container for the results of a run. Every array is appended to <model>_results.bngmm as raw column major doubles as
+soon as it is added and <model>_results.json lists the name, shape, byte offset and column labels of each array together with the run metadata.
+CSV export of every array (the files BNGMM has always written) is optional.
+ */
+#include "main.hpp"
+#include <map>
+#include <memory>
+
+struct StoredArray {
+    string name;
+    long rows;
+    long cols;
+    long offset; // bytes from the start of the container
+    vector<string> labels;
+};
+
+class ResultStore{
+    public:
+        ResultStore(const string &prefix, bool exportCsv);
+        ~ResultStore(){ close(); }
+        void add(const string &name, const MatrixXd &mat, const vector<string> &labels = vector<string>());
+        void setMetadata(const string &key, const string &value);
+        void close();
+        bool exportingCsv() const { return csv; }
+    private:
+        string basePath; // output directory and model name
+        bool csv; // also write every array to <basePath><name>.csv
+        std::shared_ptr<std::ofstream> data; // shared with the queued writes
+        long offset;
+        vector<StoredArray> arrays;
+        std::map<string, string> metadata;
+        bool closed;
+};
+
+#endif
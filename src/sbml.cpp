@@ -28,6 +28,49 @@ VectorXd simulateSBML(int useDet, double ti, double tf, const VectorXd &c0, cons
     return evolved;
 }
 
+/* Sets the initial conditions of model to a single cell, unobserved species keep their initial values from the model */
+void setCellInitialConditions(RoadRunner &model, const VectorXd &x0, const vector<int> &specifiedProteins){
+    if(specifiedProteins.size() > 0){
+        vector<double> init = model.getFloatingSpeciesInitialConcentrations();
+        for(int p = 0; p < specifiedProteins.size(); p++){
+            init[specifiedProteins[p]] = x0(p);
+        }
+        model.changeInitialConditions(init);
+    }else{
+        model.changeInitialConditions(convertInit(x0));
+    }
+}
+
+/*
+    Summary:
+        Simulates every cell (row) of x0 with the parameters currently set on model and returns the observed species at the end of the simulation.
+    Input:
+        model - roadrunner model with its global parameters already set
+        opt - simulation options (start, duration, steps)
+        x0 - initial abundances, one row per cell
+        specifiedProteins - indices of observed species in the model, empty if the columns of x0 map to the first species
+        cellSeed - if >= 0, the integrator is reseeded with cellSeed + i before cell i (common random numbers for gillespie)
+    Output:
+        Xt - matrix of the same size as x0 holding the evolved abundances
+*/
+MatrixXd simulateCells(RoadRunner &model, const SimulateOptions &opt, const MatrixXd &x0, const vector<int> &specifiedProteins, long cellSeed){
+    ScopedTimer timer(SIMULATION);
+    MatrixXd XtMat = MatrixXd::Zero(x0.rows(), x0.cols());
+    for(int i = 0; i < x0.rows(); ++i){
+        setCellInitialConditions(model, x0.row(i), specifiedProteins);
+        if(cellSeed >= 0){
+            model.getIntegrator()->setValue("seed", Setting((unsigned long) (cellSeed + i)));
+        }
+        const DoubleMatrix res = *model.simulate(&opt);
+        for(int j = 0; j < x0.cols(); ++j){
+            XtMat(i,j) = res[res.numRows() - 1][(specifiedProteins.size() > 0 ? specifiedProteins[j] : j) + 1]; // column 0 is time
+        }
+    }
+    return XtMat;
+}
+
+/* Names of the floating species in document order, the order roadrunner uses for initial conditions and simulation results. Boundary
+   (fixed, $ in BioNetGen) species are skipped so index i of the list is floating species i. */
 vector<string> getSpeciesNames(const string& path){
     vector<string> listOfSpecies;
     tinyxml2::XMLDocument doc;
@@ -38,6 +81,9 @@ vector<string> getSpeciesNames(const string& path){
         if(strcmp(child->Value(), "listOfSpecies") == 0){
             for (tinyxml2::XMLElement* species = child->FirstChildElement(); species != NULL; species = species->NextSiblingElement())
             {
+                if(species->BoolAttribute("boundaryCondition", false)){
+                    continue;
+                }
                 const char* name;
                 species->QueryStringAttribute("name", &name);
                 listOfSpecies.push_back(std::string(name));
@@ -4,8 +4,11 @@
 #include "main.hpp"
 #include "nonlinear.hpp"
 #include "tinyxml2.h"
+#include "profiler.hpp"
 
 VectorXd simulateSBML(int useDet, double ti, double tf, const VectorXd &c0, const VectorXd &k);
+void setCellInitialConditions(RoadRunner &model, const VectorXd &x0, const vector<int> &specifiedProteins);
+MatrixXd simulateCells(RoadRunner &model, const SimulateOptions &opt, const MatrixXd &x0, const vector<int> &specifiedProteins, long cellSeed = -1);
 vector<string> getSpeciesNames(const string& path);
 vector<int> specifySpeciesFromProteinsList(const string& path, vector<string> &species, int nObs);
 #endif
@@ -0,0 +1,221 @@
+#include "simulator.hpp"
+#include <Eigen/Eigenvalues>
+
+/* Copies the configured model once per thread, omp_set_num_threads must have been called before */
+CellSimulator::CellSimulator(RoadRunner &model, const SimulateOptions &options, const vector<int> &proteins){
+    opt = options;
+    specifiedProteins = proteins;
+    int nThreads = omp_get_max_threads();
+    models.reserve(nThreads);
+    for(int i = 0; i < nThreads; ++i){
+        models.push_back(model);
+    }
+}
+
+/*
+    Summary:
+        Switches stochastic simulation from roadrunner's gillespie integrator to the built in SSA engine.
+    Input:
+        netPath - BioNetGen .net file of the model
+        rateNames - names of the rate constants, matched to the .net parameters by name
+        speciesNames - names of the sbml floating species, matched to the .net species by name
+        tauLeap - tau leaping settings, exact SSA if not enabled
+    Output:
+        true if the network could be read and has every rate constant and species, otherwise the roadrunner integrator keeps being used.
+*/
+bool CellSimulator::useSSA(const string &netPath, const vector<string> &rateNames, const vector<string> &speciesNames, const TauLeapSettings &tauLeap){
+    try{
+        ReactionNetwork net = readNetFile(netPath);
+        engines.clear();
+        for(int i = 0; i < models.size(); ++i){
+            engines.push_back(SSAEngine(net));
+            engines.back().mapRates(rateNames);
+            engines.back().mapSpecies(speciesNames);
+            engines.back().setTauLeaping(tauLeap);
+        }
+        cout << "Using SSA engine with " << net.reactions.size() << " reactions and " << net.speciesNames.size() << " species from " << netPath << endl;
+        return true;
+    }catch(std::exception &e){
+        cout << e.what() << endl;
+        cout << "Falling back to roadrunner's gillespie integrator!" << endl;
+        if(tauLeap.enabled){
+            cout << "Note: Tau leaping is only available with the SSA engine, using exact simulation instead!" << endl;
+        }
+        engines.clear();
+        return false;
+    }
+}
+
+/* Settings an integrator does not know about (i.e tolerances of rk45) are skipped */
+static void setIntegratorValue(RoadRunner &model, const string &key, const Setting &value){
+    try{
+        model.getIntegrator()->setValue(key, value);
+    }catch(std::exception &e){
+        cout << "Integrator " << model.getIntegrator()->getName() << " does not support setting " << key << endl;
+    }
+}
+
+/* Applies the integrator and its tolerances to every per thread model copy */
+void CellSimulator::configureIntegrator(const IntegratorSettings &settings){
+    for(int i = 0; i < models.size(); ++i){
+        RoadRunner &model = models[i];
+        model.setIntegrator(settings.name);
+        if(settings.name == "cvode"){
+            setIntegratorValue(model, "stiff", Setting(true));
+            if(settings.relativeTolerance > 0){ setIntegratorValue(model, "relative_tolerance", Setting(settings.relativeTolerance)); }
+            if(settings.absoluteTolerance > 0){ setIntegratorValue(model, "absolute_tolerance", Setting(settings.absoluteTolerance)); }
+            if(settings.maxSteps > 0){ setIntegratorValue(model, "maximum_num_steps", Setting(settings.maxSteps)); }
+        }else if(settings.name == "rk45"){
+            if(settings.relativeTolerance > 0){ setIntegratorValue(model, "epsilon", Setting(settings.relativeTolerance)); }
+        }
+    }
+    cout << "Integrator:" << settings.name << " relative tolerance:" << settings.relativeTolerance << " absolute tolerance:" << settings.absoluteTolerance << " max steps:" << settings.maxSteps << endl;
+}
+
+/* ratio of the fastest to the slowest decaying mode of the jacobian, modes with (near) zero real part such as conservation laws are ignored */
+static double jacobianStiffness(RoadRunner &model){
+    DoubleMatrix jac = model.getFullJacobian();
+    if(jac.numRows() == 0){
+        return 1;
+    }
+    MatrixXd J(jac.numRows(), jac.numCols());
+    for(int i = 0; i < J.rows(); ++i){
+        for(int j = 0; j < J.cols(); ++j){
+            J(i,j) = jac[i][j];
+        }
+    }
+    VectorXd decay = Eigen::EigenSolver<MatrixXd>(J, false).eigenvalues().real().cwiseAbs();
+    double fastest = decay.maxCoeff();
+    double slowest = fastest;
+    for(int i = 0; i < decay.size(); ++i){
+        if(decay(i) > 1e-9 * fastest){
+            slowest = std::min(slowest, decay(i));
+        }
+    }
+    return slowest > 0 ? fastest / slowest : 1;
+}
+
+/*
+    Summary:
+        Quick stiffness probe, evaluates the jacobian of the model with rates theta at the initial state x0 and after simulating it for duration.
+    Output:
+        the larger of the two stiffness ratios
+*/
+double CellSimulator::stiffnessRatio(const VectorXd &theta, const VectorXd &x0, double start, double duration){
+    RoadRunner &model = models[slot()];
+    vector<double> values(theta.data(), theta.data() + theta.size());
+    model.getModel()->setGlobalParameterValues(values.size(), 0, values.data());
+    setCellInitialConditions(model, x0, specifiedProteins);
+    double ratio = jacobianStiffness(model);
+    SimulateOptions pOpt = opt;
+    pOpt.start = start;
+    pOpt.duration = duration;
+    model.simulate(&pOpt);
+    return std::max(ratio, jacobianStiffness(model));
+}
+
+/* Nested parallel regions (i.e a refinement inside a profile task) run with a single thread, the model belongs to the thread of the active region */
+int CellSimulator::slot() const{
+    int thread = omp_get_thread_num();
+    for(int level = omp_get_level(); level > 0; --level){
+        if(omp_get_team_size(level) > 1){
+            thread = omp_get_ancestor_thread_num(level);
+            break;
+        }
+    }
+    if(thread >= models.size()){
+        throw std::runtime_error("CellSimulator was created for fewer threads than are running!");
+    }
+    return thread;
+}
+
+/*
+    Summary:
+        Simulates every row of x0 with rate constants theta from start for duration time units.
+    Input:
+        theta - rate constants, set as the first theta.size() global parameters of the model
+        x0 - initial abundances, one row per cell
+        gen - random number generator of the caller, only used by the SSA engine when common random numbers are off
+    Output:
+        matrix of the same size as x0 with the evolved abundances
+*/
+MatrixXd CellSimulator::simulate(const VectorXd &theta, const MatrixXd &x0, double start, double duration, mt19937 &gen){
+    int s = slot();
+    if(usingSSA()){
+        engines[s].setRates(theta);
+        return engines[s].simulateCells(x0, specifiedProteins, start, start + duration, gen, crnSeed);
+    }
+    vector<double> values(theta.data(), theta.data() + theta.size());
+    models[s].getModel()->setGlobalParameterValues(values.size(), 0, values.data()); // set new global parameter values here.
+    SimulateOptions pOpt = opt;
+    pOpt.start = start;
+    pOpt.duration = duration;
+    return simulateCells(models[s], pOpt, x0, specifiedProteins, crnSeed);
+}
+
+/*
+    Summary:
+        Simulates x0 with rates theta to every time point and sums the GMM costs against the observed moments.
+    Input:
+        moments - if given, set to the simulated moments of all time points stacked into one vector (zero for time points that were
+                  not simulated because of the bound)
+        bound - stop simulating once the partial cost exceeds bound, every term is non negative for positive semi definite weights
+                so the full cost could not be below it either (i.e a particle that cannot improve its personal best)
+        cells - if given, set to the simulated cells of every simulated time point
+    Output:
+        cost, a partial cost larger than bound if the evaluation was terminated early
+*/
+double CostEvaluator::cost(const VectorXd &theta, const MatrixXd &x0, mt19937 &gen, VectorXd *moments, double bound, vector<MatrixXd> *cells){
+    double cost = 0;
+    if(moments != nullptr){
+        *moments = VectorXd::Zero(nStackedMoments());
+    }
+    if(cells != nullptr){
+        cells->clear();
+    }
+    for(int t = 1; t < times.size(); ++t){
+        MatrixXd XtMat = simulator.simulate(theta, x0, times(0), times(t), gen);
+        VectorXd XtmVec = momentVector(XtMat, nMoments);
+        if(moments != nullptr){
+            moments->segment(nMoments * (t - 1), nMoments) = XtmVec;
+        }
+        if(cells != nullptr){
+            cells->push_back(std::move(XtMat));
+        }
+        cost += costFunction(yt3Vecs[t - 1], XtmVec, weights[t - 1]);
+        if(cost > bound){
+            break;
+        }
+    }
+    return cost;
+}
+
+/* GMM cost of already known (i.e predicted) moments of all time points stacked into one vector */
+double CostEvaluator::costFromMoments(const VectorXd &moments) const{
+    double cost = 0;
+    for(int t = 1; t < times.size(); ++t){
+        cost += costFunction(yt3Vecs[t - 1], moments.segment(nMoments * (t - 1), nMoments), weights[t - 1]);
+    }
+    return cost;
+}
+
+/*
+    Summary:
+        Weighted moment residuals of all time points stacked into one vector, r = L' (y - m) with W = L L', so that the squared norm
+        of the residuals equals the GMM cost. Used by least squares refinements.
+*/
+VectorXd CostEvaluator::residuals(const VectorXd &theta, const MatrixXd &x0, mt19937 &gen){
+    VectorXd r(nMoments * (times.size() - 1));
+    for(int t = 1; t < times.size(); ++t){
+        MatrixXd XtMat = simulator.simulate(theta, x0, times(0), times(t), gen);
+        VectorXd diff = yt3Vecs[t - 1] - momentVector(XtMat, nMoments);
+        Eigen::LLT<MatrixXd> llt(weights[t - 1]);
+        if(llt.info() == Eigen::Success){
+            r.segment(nMoments * (t - 1), nMoments) = llt.matrixL().transpose() * diff;
+        }else{ // semi definite weights, use the symmetric square root
+            Eigen::SelfAdjointEigenSolver<MatrixXd> eig(weights[t - 1]);
+            r.segment(nMoments * (t - 1), nMoments) = eig.operatorSqrt() * diff;
+        }
+    }
+    return r;
+}
@@ -0,0 +1,57 @@
+#ifndef _SIMULATOR_HPP_
+#define _SIMULATOR_HPP_
+/*
+Author: John Wu
+Summary: Thread safe cell simulator used by the PSO. Keeps one roadrunner model copy (or one SSA engine for stochastic mass action models)
+per OpenMP thread so evaluations reuse their model state instead of copying the model for every particle.
+ */
+#include "main.hpp"
+#include "sbml.hpp"
+#include "ssa.hpp"
+#include "linear.hpp"
+
+/* Deterministic integrator and its error control, tolerances and step limits <= 0 keep roadrunner's defaults */
+struct IntegratorSettings {
+    string name; // "cvode" (stiff BDF) or "rk45" (non stiff explicit Runge Kutta)
+    double relativeTolerance;
+    double absoluteTolerance;
+    int maxSteps;
+};
+
+class CellSimulator{
+    public:
+        CellSimulator(RoadRunner &model, const SimulateOptions &options, const vector<int> &proteins);
+        bool useSSA(const string &netPath, const vector<string> &rateNames, const vector<string> &speciesNames, const TauLeapSettings &tauLeap);
+        bool usingSSA() const { return engines.size() > 0; }
+        void setCommonRandomNumbers(long seed){ crnSeed = seed; }
+        void configureIntegrator(const IntegratorSettings &settings);
+        double stiffnessRatio(const VectorXd &theta, const VectorXd &x0, double start, double duration);
+        MatrixXd simulate(const VectorXd &theta, const MatrixXd &x0, double start, double duration, mt19937 &gen);
+    private:
+        int slot() const;
+        vector<RoadRunner> models;
+        vector<SSAEngine> engines;
+        SimulateOptions opt;
+        vector<int> specifiedProteins;
+        long crnSeed = -1; // base seed of the per cell random streams, off when < 0
+};
+
+/* GMM cost of a rate vector summed over all time points, shared by every optimizer so they evaluate particles the same way */
+class CostEvaluator{
+    public:
+        CostEvaluator(CellSimulator &sim, const VectorXd &timePoints, const vector<VectorXd> &yMoments, const vector<MatrixXd> &yWeights, int nMom)
+            : simulator(sim), times(timePoints), yt3Vecs(yMoments), weights(yWeights), nMoments(nMom) {}
+        double cost(const VectorXd &theta, const MatrixXd &x0, mt19937 &gen, VectorXd *moments = nullptr, double bound = std::numeric_limits<double>::infinity(), vector<MatrixXd> *cells = nullptr);
+        double costFromMoments(const VectorXd &moments) const;
+        VectorXd residuals(const VectorXd &theta, const MatrixXd &x0, mt19937 &gen);
+        int nStackedMoments() const { return nMoments * (times.size() - 1); }
+        const vector<VectorXd> &targets() const { return yt3Vecs; }
+    private:
+        CellSimulator &simulator;
+        const VectorXd &times;
+        const vector<VectorXd> &yt3Vecs; // updated in place when bootstrapping
+        const vector<MatrixXd> &weights;
+        int nMoments;
+};
+
+#endif
@@ -0,0 +1,466 @@
+#include "ssa.hpp"
+#include "profiler.hpp"
+
+/* Parses a product of numbers and already defined parameters, i.e "0.5*kon", anything else is not a mass action rate we can handle */
+static RateExpression parseRateExpression(const string &expression, const map<string,int> &parameterIndex){
+    RateExpression rate = {1.0, {}};
+    std::stringstream ss(expression);
+    string factor;
+    while(std::getline(ss, factor, '*')){
+        factor.erase(std::remove_if(factor.begin(), factor.end(), ::isspace), factor.end());
+        size_t parsed = 0;
+        try{
+            double value = std::stod(factor, &parsed);
+            if(parsed == factor.size()){
+                rate.coefficient *= value;
+                continue;
+            }
+        }catch(...){}
+        auto it = parameterIndex.find(factor);
+        if(it == parameterIndex.end()){
+            throw std::runtime_error("Unsupported rate expression \"" + expression + "\" in .net file, only products of numbers and parameters are supported by the SSA engine!");
+        }
+        rate.parameters.push_back(it->second);
+    }
+    return rate;
+}
+
+/* "1,2" -> {0,1}, "0" -> {} */
+static vector<int> parseSpeciesList(const string &list){
+    vector<int> species;
+    std::stringstream ss(list);
+    string idx;
+    while(std::getline(ss, idx, ',')){
+        int i = std::stoi(idx);
+        if(i > 0){
+            species.push_back(i - 1);
+        }
+    }
+    return species;
+}
+
+/*
+    Summary:
+        Reads the parameters, species and reactions blocks of a BioNetGen .net file.
+    Input:
+        path - path to the .net file
+    Output:
+        reaction network, throws a runtime_error if the file is missing or has non mass action rate laws.
+*/
+ReactionNetwork readNetFile(const string &path){
+    std::ifstream input(path);
+    if(!input.is_open()){
+        throw std::runtime_error("Could not open network file " + path);
+    }
+    ReactionNetwork net;
+    map<string,int> parameterIndex;
+    vector<double> values; // evaluated parameters, needed for species initialized from parameters
+    string line, block = "";
+    while(std::getline(input, line)){
+        line = line.substr(0, line.find('#'));
+        std::stringstream ss(line);
+        vector<string> words;
+        string word;
+        while(ss >> word){
+            words.push_back(word);
+        }
+        if(words.size() == 0){
+            continue;
+        }
+        if(words[0] == "begin" && words.size() > 1){
+            block = words[1];
+            continue;
+        }
+        if(words[0] == "end"){
+            block = "";
+            continue;
+        }
+        if(block == "parameters" && words.size() >= 3){
+            parameterIndex[words[1]] = net.parameterNames.size();
+            net.parameterNames.push_back(words[1]);
+            net.parameterExpressions.push_back(parseRateExpression(words[2], parameterIndex));
+            double value = net.parameterExpressions.back().coefficient;
+            for(int p : net.parameterExpressions.back().parameters){
+                value *= values[p];
+            }
+            values.push_back(value);
+        }else if(block == "species" && words.size() >= 3){
+            string name = words[1];
+            net.fixedSpecies.push_back(name.size() > 0 && name[0] == '$');
+            net.speciesNames.push_back(name);
+            RateExpression init = parseRateExpression(words[2], parameterIndex);
+            double amount = init.coefficient;
+            for(int p : init.parameters){
+                amount *= values[p];
+            }
+            net.initialAmounts.push_back(amount);
+        }else if(block == "reactions" && words.size() >= 4){
+            Reaction reaction;
+            reaction.reactants = parseSpeciesList(words[1]);
+            reaction.products = parseSpeciesList(words[2]);
+            reaction.rate = parseRateExpression(words[3], parameterIndex);
+            net.reactions.push_back(reaction);
+        }
+    }
+    input.close();
+    if(net.reactions.size() == 0){
+        throw std::runtime_error("No reactions found in network file " + path);
+    }
+    return net;
+}
+
+/* BioNetGen writes model.net next to model_sbml.xml */
+string netFileFromSBML(const string &sbmlPath){
+    const string suffix = "_sbml.xml";
+    if(sbmlPath.size() > suffix.size() && sbmlPath.compare(sbmlPath.size() - suffix.size(), suffix.size(), suffix) == 0){
+        return sbmlPath.substr(0, sbmlPath.size() - suffix.size()) + ".net";
+    }
+    return sbmlPath.substr(0, sbmlPath.find_last_of('.')) + ".net";
+}
+
+SSAEngine::SSAEngine(const ReactionNetwork &network) : net(network){
+    int nReactions = net.reactions.size();
+    parameters.resize(net.parameterNames.size());
+    thetaIndex.resize(net.parameterNames.size());
+    std::iota(thetaIndex.begin(), thetaIndex.end(), 0); // .net order until mapRates is called
+    speciesIndex.resize(net.speciesNames.size());
+    std::iota(speciesIndex.begin(), speciesIndex.end(), 0); // .net order until mapSpecies is called
+    rates.resize(nReactions);
+    propensities.resize(nReactions);
+    state.resize(net.speciesNames.size());
+    changes.resize(nReactions);
+    dependents.resize(nReactions);
+    critical.resize(nReactions);
+    drift.resize(state.size());
+    spread.resize(state.size());
+    proposed.resize(state.size());
+    reactantOrders.resize(state.size());
+    tau = {false, 0.03, 10, 10, 100};
+
+    /* net change of every species per reaction */
+    for(int r = 0; r < nReactions; ++r){
+        map<int,double> delta;
+        for(int s : net.reactions[r].reactants){ delta[s] -= 1; }
+        for(int s : net.reactions[r].products){ delta[s] += 1; }
+        for(const auto &d : delta){
+            if(d.second != 0 && !net.fixedSpecies[d.first]){
+                changes[r].push_back(d);
+            }
+        }
+    }
+    /* order of every reaction and how many copies of each species it consumes, needed for the leap size bounds */
+    for(int r = 0; r < nReactions; ++r){
+        const vector<int> &reactants = net.reactions[r].reactants;
+        for(int s : reactants){
+            int multiplicity = std::count(reactants.begin(), reactants.end(), s);
+            std::pair<int,int> order(reactants.size(), multiplicity);
+            if(std::find(reactantOrders[s].begin(), reactantOrders[s].end(), order) == reactantOrders[s].end()){
+                reactantOrders[s].push_back(order);
+            }
+        }
+    }
+    /* reaction r2 depends on reaction r1 if r1 changes any reactant of r2 */
+    for(int r1 = 0; r1 < nReactions; ++r1){
+        for(int r2 = 0; r2 < nReactions; ++r2){
+            bool depends = false;
+            for(const auto &d : changes[r1]){
+                if(std::find(net.reactions[r2].reactants.begin(), net.reactions[r2].reactants.end(), d.first) != net.reactions[r2].reactants.end()){
+                    depends = true;
+                }
+            }
+            if(depends){
+                dependents[r1].push_back(r2);
+            }
+        }
+    }
+    setRates(VectorXd::Zero(0));
+}
+
+/*
+    Summary:
+        Matches every rate constant (the first global parameters of the sbml model) to the .net parameter of the same name, so the
+        rates do not depend on both files listing their parameters in the same order.
+    Input:
+        rateNames - names of the entries of theta in order
+    Output:
+        throws a runtime_error if a rate constant is not a parameter of the network
+*/
+void SSAEngine::mapRates(const vector<string> &rateNames){
+    std::fill(thetaIndex.begin(), thetaIndex.end(), -1);
+    for(size_t k = 0; k < rateNames.size(); ++k){
+        auto it = std::find(net.parameterNames.begin(), net.parameterNames.end(), rateNames[k]);
+        if(it == net.parameterNames.end()){
+            throw std::runtime_error("Rate constant " + rateNames[k] + " of the sbml model is not a parameter of the .net file!");
+        }
+        thetaIndex[it - net.parameterNames.begin()] = k;
+    }
+}
+
+/*
+    Summary:
+        Matches the floating species of the sbml model, in roadrunner's order, to the .net species by name so both engines read and write
+        the same species for every column of X. Fixed species are never floating and are skipped.
+*/
+void SSAEngine::mapSpecies(const vector<string> &speciesNames){
+    vector<int> index(speciesNames.size(), -1);
+    for(size_t k = 0; k < speciesNames.size(); ++k){
+        for(size_t s = 0; s < net.speciesNames.size(); ++s){
+            if(!net.fixedSpecies[s] && net.speciesNames[s] == speciesNames[k]){
+                index[k] = s;
+                break;
+            }
+        }
+        if(index[k] < 0){
+            throw std::runtime_error("Species " + speciesNames[k] + " of the sbml model is not a floating species of the .net file!");
+        }
+    }
+    speciesIndex = index;
+}
+
+/* Overrides the parameters mapped to theta and recomputes the remaining parameters and all reaction rates */
+void SSAEngine::setRates(const VectorXd &theta){
+    for(int p = 0; p < parameters.size(); ++p){
+        if(thetaIndex[p] >= 0 && thetaIndex[p] < theta.size()){
+            parameters[p] = theta(thetaIndex[p]);
+        }else{
+            parameters[p] = net.parameterExpressions[p].coefficient;
+            for(int f : net.parameterExpressions[p].parameters){
+                parameters[p] *= parameters[f];
+            }
+        }
+    }
+    for(int r = 0; r < rates.size(); ++r){
+        rates[r] = net.reactions[r].rate.coefficient;
+        for(int f : net.reactions[r].rate.parameters){
+            rates[r] *= parameters[f];
+        }
+    }
+}
+
+/* mass action propensity, repeated reactants use falling factorials i.e A + A -> k * A * (A - 1) (BioNetGen folds the 1/2 into the rate) */
+double SSAEngine::propensity(int r, const vector<double> &x) const{
+    double a = rates[r];
+    const vector<int> &reactants = net.reactions[r].reactants;
+    for(int i = 0; i < reactants.size(); ++i){
+        int repeats = 0;
+        for(int j = 0; j < i; ++j){
+            if(reactants[j] == reactants[i]){ repeats++; }
+        }
+        a *= std::max(x[reactants[i]] - repeats, 0.0);
+    }
+    return a;
+}
+
+/* Advances x from t0 to tf, x is updated in place with the state at tf */
+void SSAEngine::simulate(vector<double> &x, double t0, double tf, mt19937 &gen){
+    if(tau.enabled){
+        tauLeap(x, t0, tf, gen);
+    }else{
+        directSteps(x, t0, tf, -1, gen);
+    }
+}
+
+/*
+    Summary:
+        Gillespie direct method from t0 until tf or until maxEvents reactions have fired (no limit if maxEvents < 0).
+        Only propensities of dependent reactions are recomputed after each event.
+    Output:
+        time reached, tf unless the event limit was hit first
+*/
+double SSAEngine::directSteps(vector<double> &x, double t0, double tf, long maxEvents, mt19937 &gen){
+    uniform_real_distribution<double> unif(0.0, 1.0);
+    int nReactions = propensities.size();
+    double a0 = 0;
+    for(int r = 0; r < nReactions; ++r){
+        propensities[r] = propensity(r, x);
+        a0 += propensities[r];
+    }
+    double t = t0;
+    long events = 0;
+    while(a0 > 0 && (maxEvents < 0 || events < maxEvents)){
+        double next = t - std::log(1.0 - unif(gen)) / a0;
+        if(next > tf){
+            return tf;
+        }
+        t = next;
+        double target = unif(gen) * a0;
+        int fired = 0;
+        double cumulative = propensities[0];
+        while(cumulative < target && fired < nReactions - 1){
+            fired++;
+            cumulative += propensities[fired];
+        }
+        for(const auto &d : changes[fired]){
+            x[d.first] += d.second;
+        }
+        for(int r : dependents[fired]){
+            a0 -= propensities[r];
+            propensities[r] = propensity(r, x);
+            a0 += propensities[r];
+        }
+        if(++events % 1000 == 0){ // limit round off drift of the running sum
+            a0 = 0;
+            for(int r = 0; r < nReactions; ++r){
+                a0 += propensities[r];
+            }
+        }
+    }
+    return a0 > 0 ? t : tf;
+}
+
+/*
+    Summary:
+        Largest leap for which the expected change of every propensity of the non critical reactions stays within epsilon of its value
+        (Cao, Gillespie and Petzold 2006), uses the propensities and critical flags computed for x.
+*/
+double SSAEngine::leapSize(const vector<double> &x){
+    std::fill(drift.begin(), drift.end(), 0.0);
+    std::fill(spread.begin(), spread.end(), 0.0);
+    for(int r = 0; r < propensities.size(); ++r){
+        if(critical[r]){
+            continue;
+        }
+        for(const auto &d : changes[r]){
+            drift[d.first] += d.second * propensities[r];
+            spread[d.first] += d.second * d.second * propensities[r];
+        }
+    }
+    double leap = std::numeric_limits<double>::infinity();
+    for(int s = 0; s < x.size(); ++s){
+        if(reactantOrders[s].empty() || spread[s] == 0){
+            continue;
+        }
+        /* highest order of any reaction consuming s, corrected for reactions consuming several copies of s */
+        double g = 0;
+        for(const auto &order : reactantOrders[s]){
+            double gs = order.first;
+            if(order.second == 2){
+                gs = (order.first == 2 ? 1.0 : 1.5) * (2.0 + 1.0 / std::max(x[s] - 1, 1.0));
+            }else if(order.second >= 3){
+                gs = 3.0 + 1.0 / std::max(x[s] - 1, 1.0) + 2.0 / std::max(x[s] - 2, 1.0);
+            }
+            g = std::max(g, gs);
+        }
+        double bound = std::max(tau.epsilon * x[s] / g, 1.0);
+        if(drift[s] != 0){
+            leap = std::min(leap, bound / std::abs(drift[s]));
+        }
+        leap = std::min(leap, bound * bound / spread[s]);
+    }
+    return leap;
+}
+
+/*
+    Summary:
+        Tau leaping from t0 to tf. Non critical reactions fire a poisson number of times per leap, at most one critical reaction fires
+        per leap, leaps that would make a species negative are halved and leaps too short to be worth it fall back to exact SSA steps.
+*/
+void SSAEngine::tauLeap(vector<double> &x, double t0, double tf, mt19937 &gen){
+    uniform_real_distribution<double> unif(0.0, 1.0);
+    int nReactions = propensities.size();
+    double t = t0;
+    while(t < tf){
+        double a0 = 0, a0Critical = 0;
+        for(int r = 0; r < nReactions; ++r){
+            propensities[r] = propensity(r, x);
+            a0 += propensities[r];
+            critical[r] = false;
+            if(propensities[r] > 0){
+                for(const auto &d : changes[r]){
+                    if(d.second < 0 && x[d.first] / -d.second < tau.criticalCount){
+                        critical[r] = true;
+                    }
+                }
+            }
+            if(critical[r]){
+                a0Critical += propensities[r];
+            }
+        }
+        if(a0 <= 0){
+            return;
+        }
+        double leap = leapSize(x);
+        if(leap < tau.ssaThreshold / a0){
+            t = directSteps(x, t, tf, tau.ssaSteps, gen);
+            continue;
+        }
+        bool accepted = false;
+        while(!accepted){
+            double criticalLeap = a0Critical > 0 ? -std::log(1.0 - unif(gen)) / a0Critical : std::numeric_limits<double>::infinity();
+            double step = std::min(leap, criticalLeap);
+            bool fireCritical = criticalLeap <= leap;
+            bool last = t + step >= tf;
+            if(last){
+                step = tf - t;
+                fireCritical = false;
+            }
+            proposed = x;
+            for(int r = 0; r < nReactions; ++r){
+                if(critical[r] || propensities[r] * step <= 0){
+                    continue;
+                }
+                std::poisson_distribution<long> firings(propensities[r] * step);
+                long k = firings(gen);
+                for(const auto &d : changes[r]){
+                    proposed[d.first] += k * d.second;
+                }
+            }
+            if(fireCritical){
+                double target = unif(gen) * a0Critical;
+                int fired = -1;
+                double cumulative = 0;
+                for(int r = 0; r < nReactions && cumulative <= target; ++r){
+                    if(critical[r]){
+                        cumulative += propensities[r];
+                        fired = r;
+                    }
+                }
+                for(const auto &d : changes[fired]){
+                    proposed[d.first] += d.second;
+                }
+            }
+            accepted = std::none_of(proposed.begin(), proposed.end(), [](double v){ return v < 0; });
+            if(accepted){
+                std::swap(x, proposed);
+                t = last ? tf : t + step;
+                criticalFired += fireCritical;
+            }else{
+                leap /= 2;
+                rejected++;
+            }
+        }
+    }
+}
+
+/*
+    Summary:
+        Simulates every row of x0 from t0 to tf with the current rates. Column j of x0 is sbml floating species specifiedProteins[j] (or j
+        without specified proteins), the same species roadrunner uses. Unobserved species start at their .net initial amounts and
+        initial amounts are rounded to whole molecule counts. If cellSeed >= 0, cell i draws from its own stream seeded with cellSeed + i
+        instead of gen, so every parameter set sees the same random numbers per cell (common random numbers).
+    Output:
+        matrix of the same size as x0 with the observed species at tf
+*/
+MatrixXd SSAEngine::simulateCells(const MatrixXd &x0, const vector<int> &specifiedProteins, double t0, double tf, mt19937 &gen, long cellSeed){
+    ScopedTimer timer(SIMULATION);
+    MatrixXd Xt(x0.rows(), x0.cols());
+    for(int i = 0; i < x0.rows(); ++i){
+        for(int s = 0; s < state.size(); ++s){
+            state[s] = net.initialAmounts[s];
+        }
+        for(int j = 0; j < x0.cols(); ++j){
+            state[speciesIndex[specifiedProteins.size() > 0 ? specifiedProteins[j] : j]] = x0(i,j);
+        }
+        for(int s = 0; s < state.size(); ++s){
+            state[s] = std::max(std::round(state[s]), 0.0);
+        }
+        if(cellSeed >= 0){
+            cellGen.seed(cellSeed + i);
+        }
+        simulate(state, t0, tf, cellSeed >= 0 ? cellGen : gen);
+        for(int j = 0; j < x0.cols(); ++j){
+            Xt(i,j) = state[speciesIndex[specifiedProteins.size() > 0 ? specifiedProteins[j] : j]];
+        }
+    }
+    return Xt;
+}
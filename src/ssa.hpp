@@ -0,0 +1,85 @@
+#ifndef _SSA_HPP_
+#define _SSA_HPP_
+/*
+Author: John Wu
+Summary: Dedicated stochastic simulation engine (Gillespie direct method with a reaction dependency graph) for mass action networks read
+from the BioNetGen .net file that is generated next to the sbml model. Each engine owns preallocated state and propensity arrays, so one
+engine per thread can simulate many cells without allocating, and only the state at the requested time is recorded. An optional tau leaping
+mode fires many reactions per step for large copy numbers and falls back to exact SSA steps when molecule counts are low.
+ */
+#include "main.hpp"
+#include <map>
+#include <algorithm>
+
+/* A rate constant written as coefficient * product of parameters, i.e 0.5*kon */
+struct RateExpression {
+    double coefficient;
+    vector<int> parameters;
+};
+
+/* A single mass action reaction, reactants may repeat for stoichiometries larger than 1 */
+struct Reaction {
+    vector<int> reactants;
+    vector<int> products;
+    RateExpression rate;
+};
+
+struct ReactionNetwork {
+    vector<string> parameterNames;
+    vector<RateExpression> parameterExpressions; // constants are stored as a bare coefficient
+    vector<string> speciesNames;
+    vector<double> initialAmounts;
+    vector<bool> fixedSpecies;
+    vector<Reaction> reactions;
+};
+
+/* Error control of the tau leaping mode (Cao, Gillespie and Petzold 2006 step size selection) */
+struct TauLeapSettings {
+    bool enabled;
+    double epsilon; // bound on the relative change of every propensity during a leap
+    int criticalCount; // reactions within criticalCount firings of exhausting a reactant are never leaped over
+    double ssaThreshold; // leaps shorter than ssaThreshold / a0 are replaced by exact SSA steps
+    int ssaSteps; // number of exact SSA events taken when a leap is rejected for being too short
+};
+
+ReactionNetwork readNetFile(const string &path);
+string netFileFromSBML(const string &sbmlPath);
+
+class SSAEngine{
+    public:
+        SSAEngine(const ReactionNetwork &network);
+        void mapRates(const vector<string> &rateNames);
+        void mapSpecies(const vector<string> &speciesNames);
+        void setRates(const VectorXd &theta);
+        void setTauLeaping(const TauLeapSettings &settings){ tau = settings; }
+        void simulate(vector<double> &x, double t0, double tf, mt19937 &gen);
+        MatrixXd simulateCells(const MatrixXd &x0, const vector<int> &specifiedProteins, double t0, double tf, mt19937 &gen, long cellSeed = -1);
+        int nSpecies() const { return net.speciesNames.size(); }
+        long rejectedLeaps() const { return rejected; }
+        long criticalFirings() const { return criticalFired; }
+    protected:
+        double propensity(int r, const vector<double> &x) const;
+        double directSteps(vector<double> &x, double t0, double tf, long maxEvents, mt19937 &gen);
+        void tauLeap(vector<double> &x, double t0, double tf, mt19937 &gen);
+        double leapSize(const vector<double> &x);
+        ReactionNetwork net;
+        vector<double> parameters; // current values of all parameters after theta has been applied
+        vector<int> thetaIndex; // entry of theta that sets each parameter, -1 if the parameter keeps its .net value
+        vector<int> speciesIndex; // .net species of every sbml floating species, the indices used by specifiedProteins and the X columns
+        vector<double> rates; // rate constant of each reaction
+        vector<double> propensities;
+        vector<vector<std::pair<int,double>>> changes; // (species, net change) of each reaction, fixed species excluded
+        vector<vector<int>> dependents; // reactions whose propensity must be recomputed after a reaction fires
+        vector<vector<std::pair<int,int>>> reactantOrders; // (reaction order, multiplicity of the species) of every reaction consuming a species
+        vector<double> state;
+        TauLeapSettings tau;
+        vector<bool> critical;
+        vector<double> drift; // expected change of each species per unit time from non critical reactions
+        vector<double> spread; // variance of that change
+        vector<double> proposed; // state after a leap, kept only if no species went negative
+        mt19937 cellGen; // per cell stream used for common random numbers
+        long rejected = 0; // leaps halved because a species went negative
+        long criticalFired = 0; // critical reactions fired inside an accepted leap
+};
+
+#endif
@@ -0,0 +1,86 @@
+#include "surrogate.hpp"
+
+/* keeps only the most recent capacity points, which are closest to where the swarm currently searches */
+void MomentSurrogate::add(const VectorXd &position, const VectorXd &moments){
+    positions.push_back(position);
+    samples.push_back(moments);
+    if(positions.size() > static_cast<size_t>(capacity)){
+        positions.erase(positions.begin());
+        samples.erase(samples.begin());
+    }
+}
+
+void MomentSurrogate::clear(){
+    positions.clear();
+    samples.clear();
+    trained = false;
+}
+
+double MomentSurrogate::kernel(const VectorXd &a, const VectorXd &b) const{
+    return std::exp(-0.5 * (a - b).squaredNorm() / (lengthScale * lengthScale));
+}
+
+/*
+    Summary:
+        Fits a squared exponential Gaussian process with a shared kernel for every (standardized) moment. The length scale is set by the
+        median heuristic on the training positions.
+*/
+void MomentSurrogate::fit(){
+    int n = positions.size();
+    if(n == 0 || n < 2 * positions[0].size() + 2){ // too few points to say anything useful
+        trained = false;
+        return;
+    }
+    int m = samples[0].size();
+    X.resize(n, positions[0].size());
+    MatrixXd Y(n, m);
+    for(int i = 0; i < n; ++i){
+        X.row(i) = positions[i];
+        Y.row(i) = samples[i];
+    }
+    mean = Y.colwise().mean();
+    scale = ((Y.rowwise() - mean.transpose()).array().square().colwise().sum() / (n - 1)).sqrt().matrix().transpose();
+    scale = scale.cwiseMax(1e-12);
+
+    vector<double> distances;
+    for(int i = 0; i < n; ++i){
+        for(int j = i + 1; j < n; ++j){
+            distances.push_back((X.row(i) - X.row(j)).norm());
+        }
+    }
+    std::nth_element(distances.begin(), distances.begin() + distances.size() / 2, distances.end());
+    lengthScale = std::max(distances[distances.size() / 2], 1e-6);
+
+    MatrixXd K(n, n);
+    for(int i = 0; i < n; ++i){
+        for(int j = 0; j <= i; ++j){
+            K(i,j) = kernel(X.row(i), X.row(j));
+            K(j,i) = K(i,j);
+        }
+        K(i,i) += nugget;
+    }
+    llt.compute(K);
+    if(llt.info() != Eigen::Success){
+        trained = false;
+        return;
+    }
+    MatrixXd standardized = (Y.rowwise() - mean.transpose()).array().rowwise() / scale.transpose().array();
+    alpha = llt.solve(standardized);
+    trained = true;
+}
+
+/*
+    Summary:
+        Posterior mean of the moments at position.
+    Output:
+        relativeVariance - posterior variance over prior variance, near 0 close to training points and 1 far away from them
+*/
+VectorXd MomentSurrogate::predict(const VectorXd &position, double &relativeVariance) const{
+    VectorXd k(X.rows());
+    for(int i = 0; i < X.rows(); ++i){
+        k(i) = kernel(X.row(i), position);
+    }
+    relativeVariance = std::max(0.0, 1.0 - k.dot(llt.solve(k)));
+    VectorXd standardized = alpha.transpose() * k;
+    return mean + standardized.cwiseProduct(scale);
+}
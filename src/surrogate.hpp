@@ -0,0 +1,34 @@
+#ifndef _SURROGATE_HPP_
+#define _SURROGATE_HPP_
+/*
+Author: John Wu
+Summary: Gaussian process surrogate of the simulated moments, trained on the (position, moments) pairs of every particle evaluation
+(the same pairs --surrogate writes to disk). The PSO uses it to skip simulating particles that are predicted, with confidence, not to
+improve their personal best.
+ */
+#include "main.hpp"
+
+class MomentSurrogate{
+    public:
+        MomentSurrogate(int maxPoints, double noise) : capacity(maxPoints), nugget(noise), trained(false) {}
+        void add(const VectorXd &position, const VectorXd &moments);
+        void fit();
+        bool ready() const { return trained; }
+        VectorXd predict(const VectorXd &position, double &relativeVariance) const;
+        void clear();
+    private:
+        double kernel(const VectorXd &a, const VectorXd &b) const;
+        int capacity; // most recent points kept for training, fitting is cubic in it
+        double nugget; // noise variance relative to the kernel variance, larger for stochastic simulation
+        bool trained;
+        vector<VectorXd> positions;
+        vector<VectorXd> samples;
+        MatrixXd X; // training positions, one row per point
+        MatrixXd alpha; // K^-1 (Y - mean) / scale
+        VectorXd mean;
+        VectorXd scale;
+        double lengthScale;
+        Eigen::LLT<MatrixXd> llt;
+};
+
+#endif
@@ -0,0 +1,409 @@
+/*
+Author: John Wu
+Summary: Deterministic checks of the simulation engines and numerical kernels against known answers. Every check prints one line and the
+program exits with a failure code if any of them did not hold, so it can be run by ctest.
+
+Usage:
+    ./bngmm_tests [--filter ssa]
+ */
+#include "main.hpp"
+#include "ssa.hpp"
+#include "simulator.hpp"
+#include "linear.hpp"
+#include "calc.hpp"
+#include "optimize.hpp"
+#include "surrogate.hpp"
+#include <iomanip>
+#include <atomic>
+
+static int failures = 0;
+static string nameFilter = "";
+
+/* Prints whether condition held, with the measured and expected values for failures */
+void check(const string &name, bool condition, double measured = 0, double expected = 0){
+    cout << (condition ? "PASS " : "FAIL ") << name;
+    if(!condition){
+        cout << " (measured " << measured << ", expected " << expected << ")";
+        failures++;
+    }
+    cout << endl;
+}
+
+void checkNear(const string &name, double measured, double expected, double tolerance){
+    check(name, std::abs(measured - expected) <= tolerance, measured, expected);
+}
+
+bool selected(const string &name){
+    return nameFilter == "" || name.find(nameFilter) != string::npos;
+}
+
+/* 0 -> A at rate kb, A -> 0 at rate kd, A is Poisson distributed with mean and variance kb/kd at stationarity */
+ReactionNetwork birthDeath(double kb, double kd){
+    ReactionNetwork net;
+    net.parameterNames = {"kb", "kd"};
+    net.parameterExpressions = {{kb, {}}, {kd, {}}};
+    net.speciesNames = {"A"};
+    net.initialAmounts = {0};
+    net.fixedSpecies = {false};
+    net.reactions = {{{}, {0}, {1.0, {0}}}, {{0}, {}, {1.0, {1}}}};
+    return net;
+}
+
+void testSSA(){
+    const int nCells = 4000;
+    SSAEngine engine(birthDeath(10, 1));
+    mt19937 gen(7);
+    MatrixXd x0 = MatrixXd::Zero(nCells, 1);
+    MatrixXd Xt = engine.simulateCells(x0, {}, 0, 20, gen); // 20 lifetimes, far past the relaxation time 1/kd
+    VectorXd moments = momentVector(Xt, 2);
+    /* 4 standard errors, the variance of a Poisson sample variance is (mu4 - sigma^4) / n = lambda (1 + 2 lambda) / n */
+    checkNear("ssa/birthDeath/mean", moments(0), 10, 4 * std::sqrt(10.0 / nCells));
+    checkNear("ssa/birthDeath/variance", moments(1), 10, 4 * std::sqrt(10.0 * 21 / nCells));
+
+    /* rates are matched by name, so theta in the sbml order kd, kb sets the same network */
+    engine.mapRates({"kd", "kb"});
+    VectorXd theta(2);
+    theta << 1, 10;
+    engine.setRates(theta);
+    Xt = engine.simulateCells(x0, {}, 0, 20, gen);
+    checkNear("ssa/mapRates/mean", Xt.mean(), 10, 4 * std::sqrt(10.0 / nCells));
+    bool thrown = false;
+    try{
+        engine.mapRates({"kb", "kdeg"});
+    }catch(std::runtime_error &e){
+        thrown = true;
+    }
+    check("ssa/mapRates/unknownName", thrown);
+}
+
+/* A fixed species and a .net species order different from the sbml one, only B (unobserved) changes */
+const char *columnsSBML = R"xml(<?xml version="1.0" encoding="UTF-8"?>
+<sbml xmlns="http://www.sbml.org/sbml/level2/version3" level="2" version="3">
+  <model id="columns">
+    <listOfCompartments>
+      <compartment id="cell" size="1"/>
+    </listOfCompartments>
+    <listOfSpecies>
+      <species id="S1" compartment="cell" initialAmount="1" boundaryCondition="true" name="$F()"/>
+      <species id="S2" compartment="cell" initialAmount="0" name="A()"/>
+      <species id="S3" compartment="cell" initialAmount="5" name="B()"/>
+      <species id="S4" compartment="cell" initialAmount="0" name="C()"/>
+    </listOfSpecies>
+    <listOfParameters>
+      <parameter id="kb" value="2"/>
+      <parameter id="kd" value="1"/>
+    </listOfParameters>
+    <listOfReactions>
+      <reaction id="R1" reversible="false">
+        <listOfReactants>
+          <speciesReference species="S1"/>
+        </listOfReactants>
+        <listOfProducts>
+          <speciesReference species="S1"/>
+          <speciesReference species="S3"/>
+        </listOfProducts>
+        <kineticLaw>
+          <math xmlns="http://www.w3.org/1998/Math/MathML">
+            <apply>
+              <times/>
+              <ci> kb </ci>
+              <ci> S1 </ci>
+            </apply>
+          </math>
+        </kineticLaw>
+      </reaction>
+      <reaction id="R2" reversible="false">
+        <listOfReactants>
+          <speciesReference species="S3"/>
+        </listOfReactants>
+        <kineticLaw>
+          <math xmlns="http://www.w3.org/1998/Math/MathML">
+            <apply>
+              <times/>
+              <ci> kd </ci>
+              <ci> S3 </ci>
+            </apply>
+          </math>
+        </kineticLaw>
+      </reaction>
+    </listOfReactions>
+  </model>
+</sbml>
+)xml";
+
+const char *columnsNet = R"net(begin parameters
+    1 kb 2
+    2 kd 1
+end parameters
+begin species
+    1 $F() 1
+    2 C() 0
+    3 B() 5
+    4 A() 0
+end species
+begin reactions
+    1 1 1,3 kb
+    2 3 0 kd
+end reactions
+)net";
+
+/* with -p the columns of X must hold the same species whichever engine simulates them */
+void testEngineColumns(){
+    fs::path dir = fs::temp_directory_path() / "bngmm_tests_columns";
+    fs::create_directories(dir);
+    string sbmlPath = (dir / "columns_sbml.xml").string(), proteinsPath = (dir / "proteins.txt").string();
+    std::ofstream(sbmlPath) << columnsSBML;
+    std::ofstream(netFileFromSBML(sbmlPath)) << columnsNet;
+    std::ofstream(proteinsPath) << "C()" << endl << "A()" << endl;
+
+    vector<string> speciesNames = getSpeciesNames(sbmlPath);
+    check("columns/floatingSpecies", speciesNames == vector<string>({"A()", "B()", "C()"}), speciesNames.size(), 3);
+    vector<int> proteins = specifySpeciesFromProteinsList(proteinsPath, speciesNames, 2);
+
+    RoadRunner model(sbmlPath);
+    model.setIntegrator("cvode");
+    SimulateOptions opt;
+    opt.steps = 10;
+    CellSimulator roadrunner(model, opt, proteins);
+    CellSimulator ssa(model, opt, proteins);
+    TauLeapSettings exact = {false, 0.03, 10, 10, 100};
+    check("columns/ssaEngine", ssa.useSSA(netFileFromSBML(sbmlPath), {"kb", "kd"}, speciesNames, exact));
+
+    MatrixXd x0(4, 2);
+    x0 << 3, 7,
+          0, 12,
+          9, 1,
+          4, 4;
+    VectorXd theta(2);
+    theta << 2, 1;
+    mt19937 gen(5);
+    MatrixXd rrXt = roadrunner.simulate(theta, x0, 0, 3, gen);
+    MatrixXd ssaXt = ssa.simulate(theta, x0, 0, 3, gen);
+    checkNear("columns/roadrunner", (rrXt - x0).cwiseAbs().maxCoeff(), 0, 1e-6);
+    checkNear("columns/ssa", (ssaXt - x0).cwiseAbs().maxCoeff(), 0, 0);
+    checkNear("columns/agree", (rrXt - ssaXt).cwiseAbs().maxCoeff(), 0, 1e-6);
+    fs::remove_all(dir);
+}
+
+/* relative difference of two sample moments, |a - b| / |b| */
+double relativeDifference(double a, double b){
+    return std::abs(a - b) / std::abs(b);
+}
+
+void testTauLeaping(){
+    const int nCells = 4000;
+    /* A decays from 1000 copies (non critical, leaps of many firings), B is born and decays at a few copies (critical, fired exactly) */
+    ReactionNetwork net;
+    net.parameterNames = {"kd", "lb", "ld"};
+    net.parameterExpressions = {{1, {}}, {2, {}}, {1, {}}};
+    net.speciesNames = {"A", "B"};
+    net.initialAmounts = {1000, 0};
+    net.fixedSpecies = {false, false};
+    net.reactions = {{{0}, {}, {1.0, {0}}}, {{}, {1}, {1.0, {1}}}, {{1}, {}, {1.0, {2}}}};
+    SSAEngine direct(net), leaping(net);
+    leaping.setTauLeaping({true, 0.03, 10, 10, 100});
+    mt19937 gen(11);
+    MatrixXd x0 = MatrixXd::Zero(nCells, 2);
+    x0.col(0).setConstant(1000);
+    VectorXd exact = momentVector(direct.simulateCells(x0, {}, 0, 0.5, gen), 5);
+    VectorXd leaped = momentVector(leaping.simulateCells(x0, {}, 0, 0.5, gen), 5);
+    /* tau leaping is biased by O(epsilon), i.e the mean of a linear decay shrinks by (1 - k tau) instead of exp(-k tau) per leap */
+    check("tau/decay/mean", relativeDifference(leaped(0), exact(0)) < 0.02, leaped(0), exact(0));
+    check("tau/decay/variance", relativeDifference(leaped(2), exact(2)) < 0.15, leaped(2), exact(2));
+    checkNear("tau/critical/mean", leaped(1), exact(1), 4 * std::sqrt(2 * exact(3) / nCells));
+    checkNear("tau/critical/variance", leaped(3), exact(3), 4 * std::sqrt(2 * exact(3) * (1 + 2 * exact(3)) / nCells) + 0.1 * exact(3));
+    check("tau/critical/fired", leaping.criticalFirings() > 0, leaping.criticalFirings(), 1);
+
+    /* no critical reactions and no fall back to exact steps, so leaps over the last few molecules overshoot and are halved */
+    ReactionNetwork decay;
+    decay.parameterNames = {"kd"};
+    decay.parameterExpressions = {{1, {}}};
+    decay.speciesNames = {"A"};
+    decay.initialAmounts = {20};
+    decay.fixedSpecies = {false};
+    decay.reactions = {{{0}, {}, {1.0, {0}}}};
+    SSAEngine directDecay(decay), leapingDecay(decay);
+    leapingDecay.setTauLeaping({true, 0.03, 0, 0, 100});
+    MatrixXd x20 = MatrixXd::Constant(nCells, 1, 20);
+    exact = momentVector(directDecay.simulateCells(x20, {}, 0, 4, gen), 2);
+    MatrixXd leapedCells = leapingDecay.simulateCells(x20, {}, 0, 4, gen);
+    leaped = momentVector(leapedCells, 2);
+    checkNear("tau/halving/mean", leaped(0), exact(0), 4 * std::sqrt(2 * exact(1) / nCells));
+    /* the sample variance of a nearly poisson count with variance v has a variance of about v (1 + 2 v) / n */
+    checkNear("tau/halving/variance", leaped(1), exact(1), 4 * std::sqrt(2 * exact(1) * (1 + 2 * exact(1)) / nCells) + 0.1 * exact(1));
+    check("tau/halving/rejected", leapingDecay.rejectedLeaps() > 0, leapingDecay.rejectedLeaps(), 1);
+    check("tau/halving/nonNegative", leapedCells.minCoeff() >= 0, leapedCells.minCoeff(), 0);
+}
+
+/* bowl with its minimum at (0.3, 0.7, 0.5) inside the unit cube */
+double quadratic(const VectorXd &x){
+    VectorXd center(3);
+    center << 0.3, 0.7, 0.5;
+    return (x - center).squaredNorm();
+}
+
+/* Rosenbrock's valley on [-2,2]^2 mapped to the unit square, its minimum (1,1) is at (0.75, 0.75) */
+double rosenbrock(const VectorXd &x){
+    double u = 4 * x(0) - 2, v = 4 * x(1) - 2;
+    return (1 - u) * (1 - u) + 100 * (v - u * u) * (v - u * u);
+}
+
+void testDirectSearch(){
+    VectorXd start = VectorXd::Constant(3, 0.5);
+    start(0) = 0.9;
+    RefinementResult result = nelderMead(quadratic, start, quadratic(start), 2000);
+    checkNear("nelderMead/quadratic", quadratic(result.position), 0, 1e-10);
+    VectorXd corner = VectorXd::Constant(2, 0.25);
+    result = nelderMead(rosenbrock, corner, rosenbrock(corner), 5000);
+    checkNear("nelderMead/rosenbrock", (result.position - VectorXd::Constant(2, 0.75)).norm(), 0, 1e-4);
+
+    result = patternSearch(quadratic, start, quadratic(start), 2000);
+    checkNear("patternSearch/quadratic", (result.position - Eigen::Vector3d(0.3, 0.7, 0.5)).norm(), 0, 1e-5);
+    result = patternSearch(rosenbrock, corner, rosenbrock(corner), 200000);
+    checkNear("patternSearch/rosenbrock", (result.position - VectorXd::Constant(2, 0.75)).norm(), 0, 1e-2);
+
+    /* budgets that run out in the middle of expansion, contraction and shrink steps, every evaluation is counted by the objective itself */
+    long overshootNM = 0, overshootPS = 0, mismatches = 0;
+    for(long budget = 0; budget <= 200; ++budget){ // below 6 the initial simplex alone would overshoot
+        std::atomic<long> calls(0);
+        Objective counted = [&](const VectorXd &x){ calls++; return rosenbrock(x.head(2)) + x.tail(x.size() - 2).squaredNorm(); };
+        VectorXd wide = VectorXd::Constant(6, 0.25);
+        result = nelderMead(counted, wide, rosenbrock(wide.head(2)) + wide.tail(4).squaredNorm(), budget);
+        overshootNM = std::max(overshootNM, calls - budget);
+        mismatches += result.evaluations != calls;
+        calls = 0;
+        result = patternSearch(counted, wide, rosenbrock(wide.head(2)) + wide.tail(4).squaredNorm(), budget);
+        overshootPS = std::max(overshootPS, calls - budget);
+        mismatches += result.evaluations != calls;
+    }
+    check("nelderMead/budget", overshootNM <= 0, overshootNM, 0);
+    check("patternSearch/budget", overshootPS <= 0, overshootPS, 0);
+    check("directSearch/evaluationCount", mismatches == 0, mismatches, 0);
+}
+
+void testLevenbergMarquardt(){
+    /* overdetermined linear least squares, r(x) = A x - b with the exact solution inside the unit cube */
+    MatrixXd A(5, 3);
+    A << 1, 2, 0,
+         0, 1, 3,
+         2, 0, 1,
+         1, 1, 1,
+         3, 0, 2;
+    VectorXd solution(3);
+    solution << 0.2, 0.6, 0.4;
+    VectorXd b = A * solution;
+    ResidualFunction linear = [&](const VectorXd &x){ return VectorXd(A * x - b); };
+    VectorXd start = VectorXd::Constant(3, 0.9);
+    RefinementResult result = levenbergMarquardt(linear, start, linear(start).squaredNorm(), 200);
+    checkNear("levenbergMarquardt/linear", (result.position - solution).norm(), 0, 1e-6);
+    check("levenbergMarquardt/budget", result.evaluations <= 200, result.evaluations, 200);
+
+    /* the caller's cost of the start is the one to beat, a start already better than any reachable point is kept */
+    result = levenbergMarquardt(linear, start, -1, 200);
+    check("levenbergMarquardt/startCost", result.position == start && result.cost == -1, result.cost, -1);
+
+    /* inconsistent system, the answer is the normal equations solution */
+    b(0) += 0.1;
+    VectorXd leastSquares = (A.transpose() * A).ldlt().solve(A.transpose() * b);
+    result = levenbergMarquardt(linear, start, linear(start).squaredNorm(), 200);
+    checkNear("levenbergMarquardt/leastSquares", (result.position - leastSquares).norm(), 0, 1e-6);
+}
+
+void testCMAES(){
+    GenerationCallback never = [](const MatrixXd &, const VectorXd &, double){ return false; };
+    CMAESSettings settings = {0, 300, 0.3, 5};
+    RefinementResult result = cmaes(quadratic, VectorXd::Constant(3, 0.9), settings, never);
+    checkNear("cmaes/quadratic", (result.position - Eigen::Vector3d(0.3, 0.7, 0.5)).norm(), 0, 1e-5);
+    settings.maxGenerations = 1000;
+    result = cmaes(rosenbrock, VectorXd::Constant(2, 0.25), settings, never);
+    checkNear("cmaes/rosenbrock", (result.position - VectorXd::Constant(2, 0.75)).norm(), 0, 1e-4);
+
+    /* the free minimum lies outside the unit cube (only the first coordinate has an interior optimum, 0.5), so most samples need repairing and every one must end up inside it */
+    std::atomic<long> outside(0);
+    Objective beyond = [&](const VectorXd &x){
+        if(x.minCoeff() < 0 || x.maxCoeff() > 1){ outside++; }
+        return (x - VectorXd::Constant(x.size(), 1.5)).squaredNorm() + (x(0) + 0.5) * (x(0) + 0.5);
+    };
+    GenerationCallback inspect = [&](const MatrixXd &population, const VectorXd &best, double){
+        if(population.minCoeff() < 0 || population.maxCoeff() > 1 || best.minCoeff() < 0 || best.maxCoeff() > 1){ outside++; }
+        return false;
+    };
+    settings = {12, 200, 0.5, 9};
+    result = cmaes(beyond, VectorXd::Constant(4, 0.5), settings, inspect);
+    check("cmaes/clamped/inside", outside == 0, outside, 0);
+    VectorXd corner = VectorXd::Ones(4);
+    corner(0) = 0.5;
+    checkNear("cmaes/clamped/optimum", (result.position - corner).norm(), 0, 1e-3);
+}
+
+void testSurrogate(){
+    MomentSurrogate surrogate(50, 1e-6);
+    surrogate.fit(); // nothing to train on yet
+    check("surrogate/empty", !surrogate.ready(), surrogate.ready(), false);
+    for(int i = 0; i < 30; ++i){
+        VectorXd position = VectorXd::Constant(2, i / 29.0);
+        position(1) = 1 - position(1) * position(1);
+        surrogate.add(position, (VectorXd(2) << position.sum(), position(0) * position(1)).finished());
+    }
+    surrogate.fit();
+    double relativeVariance;
+    VectorXd predicted = surrogate.predict(Eigen::Vector2d(0.5, 0.75), relativeVariance);
+    check("surrogate/trained", surrogate.ready(), surrogate.ready(), true);
+    checkNear("surrogate/interpolates", predicted(0), 1.25, 1e-2);
+    surrogate.clear();
+    surrogate.fit();
+    check("surrogate/cleared", !surrogate.ready(), surrogate.ready(), false);
+}
+
+/* bootstrap replicates weighted by draw counts must equal the moments and weights of the materialized resample */
+void testBootstrapMoments(){
+    mt19937 gen(3);
+    std::gamma_distribution<double> abundance(2.0, 5.0);
+    MatrixXd Y(300, 3);
+    for(int i = 0; i < Y.rows(); ++i){
+        for(int j = 0; j < Y.cols(); ++j){
+            Y(i,j) = abundance(gen) + (j > 0 ? 0.5 * Y(i, j - 1) : 0);
+        }
+    }
+    for(int nMoments : {3, 6, 9}){
+        for(bool useInverse : {false, true}){
+            string name = "bootstrap/" + to_string(nMoments) + (useInverse ? "/inverse" : "/diagonal");
+            MatrixXd contributions = momentContributions(Y, nMoments);
+            VectorXd moments;
+            MatrixXd weights;
+            bootstrapMoments(contributions, VectorXd::Ones(Y.rows()), Y.cols(), useInverse, moments, weights);
+            MatrixXd expectedWeights = wolfWtMat(Y, nMoments, useInverse);
+            checkNear(name + "/onesMoments", (moments - momentVector(Y, nMoments)).norm() / momentVector(Y, nMoments).norm(), 0, 1e-12);
+            checkNear(name + "/onesWeights", (weights - expectedWeights).norm() / expectedWeights.norm(), 0, 1e-8);
+
+            mt19937 bGen = bootstrapGenerator(7, 1, 1);
+            VectorXd counts = bootstrapCounts(Y.rows(), bGen);
+            MatrixXd resampled = resampleRows(Y, counts);
+            bootstrapMoments(contributions, counts, Y.cols(), useInverse, moments, weights);
+            expectedWeights = wolfWtMat(resampled, nMoments, useInverse);
+            checkNear(name + "/resampleMoments", (moments - momentVector(resampled, nMoments)).norm() / momentVector(resampled, nMoments).norm(), 0, 1e-12);
+            checkNear(name + "/resampleWeights", (weights - expectedWeights).norm() / expectedWeights.norm(), 0, 1e-8);
+        }
+    }
+}
+
+int main(int argc, char** argv){
+    for(int i = 1; i < argc - 1; ++i){
+        string arg = argv[i];
+        if(arg == "--filter"){
+            nameFilter = argv[i + 1];
+        }
+    }
+    omp_set_num_threads(1);
+    cout << std::setprecision(6);
+    if(selected("ssa")){ testSSA(); }
+    if(selected("columns")){ testEngineColumns(); }
+    if(selected("tau")){ testTauLeaping(); }
+    if(selected("nelderMead") || selected("patternSearch")){ testDirectSearch(); }
+    if(selected("levenbergMarquardt")){ testLevenbergMarquardt(); }
+    if(selected("cmaes")){ testCMAES(); }
+    if(selected("surrogate")){ testSurrogate(); }
+    if(selected("bootstrap")){ testBootstrapMoments(); }
+    cout << failures << " checks failed" << endl;
+    return failures > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}